@@ -7,18 +7,32 @@
 #include "audio_base.h"
 #include "input_base.h"
 #include "throttle.h"
+#include "sram_persist.h"
 
 #include <variables.h>
+#include <memory_map.h>
+#include <cheat_search.h>
+#include <cheat_engine.h>
 #include <i18n.h>
 #include <core.h>
 #include <helper.h>
 #include <perf.h>
+#include <async_writer.h>
+
+#include <miniz.h>
 
 #include <memory>
 #include <cstring>
 #include <cstdarg>
 #include <cmath>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace drivers {
 
 inline void lowered_string(std::string &s) {
@@ -46,7 +60,12 @@ driver_base *current_driver = nullptr;
 
 driver_base::driver_base() {
     frame_throttle = std::make_shared<throttle>();
+    save_persist = std::make_unique<sram_persist>();
+    rtc_persist = std::make_unique<sram_persist>();
     variables = std::make_unique<libretro::retro_variables>();
+    memory_map = std::make_unique<libretro::memory_map>();
+    cheat_finder = std::make_unique<libretro::cheat_search>();
+    cheats = std::make_unique<libretro::cheat_engine>();
 
     system_dir = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "system";
     helper::mkdir(system_dir);
@@ -84,6 +103,14 @@ void driver_base::run(const std::function<void()> &in_game_menu_cb) {
         }
 
         core->retro_run();
+        /* RAM cheats override values written by core in this frame */
+        if (cheats->need_compile()) {
+            /* same regions as cheat search, so that cheats added from search results hit the same bytes */
+            std::vector<libretro::memory_region> regions;
+            get_memory_regions(regions);
+            cheats->compile(regions);
+        }
+        cheats->apply();
         if (video->frame_drawn()) {
             int64_t usecs = frame_throttle->check_wait();
             if (usecs > 0) {
@@ -101,12 +128,12 @@ void driver_base::run(const std::function<void()> &in_game_menu_cb) {
 
         auto check = g_cfg.get_save_check();
         if (check) {
-            if (!save_check_countdown) {
-                check_save_ram();
-                save_check_countdown = lround(check * fps);
-            } else {
-                save_check_countdown--;
-            }
+            /* only hashes a few pages per frame, files are written by a worker thread */
+            auto now = helper::get_ticks_usec();
+            save_persist->check(core->retro_get_memory_data(RETRO_MEMORY_SAVE_RAM),
+                                core->retro_get_memory_size(RETRO_MEMORY_SAVE_RAM), now, check * 1000000ULL);
+            rtc_persist->check(core->retro_get_memory_data(RETRO_MEMORY_RTC),
+                               core->retro_get_memory_size(RETRO_MEMORY_RTC), now, check * 1000000ULL);
         }
     }
 }
@@ -174,16 +201,28 @@ static bool RETRO_CALLCONV retro_set_rumble_state_cb(unsigned port, enum retro_r
     return false;
 }
 
-bool driver_base::load_game(const std::string &path) {
+bool driver_base::load_game(const std::string &path, const std::string &entry) {
     retro_game_info info = {};
-    info.path = path.c_str();
+    /* entry is appended as a subdirectory, so that cores resolve files referred by cue sheets
+     * and playlists relative to it inside the archive */
+    std::string full_path = entry.empty() ? path : path + "/" + entry;
+    info.path = full_path.c_str();
     if (!need_fullpath) {
-        if (!helper::read_file(path, game_data)) {
-            LOG(ERROR, "Unable to load file {}", path);
-            return false;
+        /* map rom file directly so that it is not copied into memory before core copies it,
+         * use copy-on-write mapping as some cores patch data in place despite it being const */
+        if (!game_mapping) game_mapping = std::make_unique<helper::mapped_file>();
+        if (entry.empty() && game_mapping->open(path, true)) {
+            game_mapping->prefetch();
+            info.data = game_mapping->data();
+            info.size = game_mapping->size();
+        } else {
+            if (!helper::read_file(full_path, game_data)) {
+                LOG(ERROR, "Unable to load file {}", full_path);
+                return false;
+            }
+            info.data = game_data.data();
+            info.size = game_data.size();
         }
-        info.data = &game_data[0];
-        info.size = game_data.size();
     }
     serialization_quirks = 0;
     if (!core->retro_load_game(&info)) {
@@ -196,23 +235,78 @@ bool driver_base::load_game(const std::string &path) {
     return true;
 }
 
-bool driver_base::load_game_from_mem(const std::string &path, const std::string &ext, const std::vector<uint8_t> &data) {
+#ifdef __linux__
+/* create an empty in-memory file, return fd or -1 if not supported */
+static int create_memfd(const std::string &name) {
+#ifdef SYS_memfd_create
+    return static_cast<int>(syscall(SYS_memfd_create, name.c_str(), 1U /* MFD_CLOEXEC */));
+#else
+    (void)name;
+    return -1;
+#endif
+}
+
+static bool write_fd(int fd, const void *data, size_t size) {
+    const auto *ptr = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        auto n = write(fd, ptr, size);
+        if (n <= 0) return false;
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+#endif
+
+bool driver_base::create_temp_file(const std::string &path, const std::string &ext,
+                                   const std::function<bool(const content_writer&)> &fill) {
+    std::string basename = get_base_name(path);
+    temp_file = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "tmp";
+    helper::mkdir(temp_file);
+    temp_file = temp_file + PATH_SEPARATOR_CHAR + basename + "." + ext;
+    remove(temp_file.c_str());
+#ifdef __linux__
+    /* keep content in a memfd and give core a symlink to /proc/self/fd/N,
+     * so that core still sees the original file extension,
+     * and only the symlink is left behind on crash */
+    temp_fd = create_memfd(basename + "." + ext);
+    if (temp_fd >= 0) {
+        int fd = temp_fd;
+        if (fill([fd](const void *data, size_t size) { return write_fd(fd, data, size); })
+            && lseek(fd, 0, SEEK_SET) == 0
+            && symlink(("/proc/self/fd/" + std::to_string(fd)).c_str(), temp_file.c_str()) == 0) {
+            return true;
+        }
+        ::close(temp_fd);
+        temp_fd = -1;
+        remove(temp_file.c_str());
+    }
+#endif
+    FILE *fp = fopen(temp_file.c_str(), "wb");
+    bool ok = fp && fill([fp](const void *data, size_t size) { return fwrite(data, 1, size, fp) == size; });
+    if (fp && fclose(fp) != 0) ok = false;
+    if (!ok) {
+        remove(temp_file.c_str());
+        temp_file.clear();
+    }
+    return ok;
+}
+
+bool driver_base::load_game_from_mem(const std::string &path, const std::string &ext, std::vector<uint8_t> &&data) {
     retro_game_info info = {};
     if (!need_fullpath) {
-        game_data.assign(data.begin(), data.end());
+        game_data = std::move(data);
         info.path = path.c_str();
-        info.data = &game_data[0];
+        info.data = game_data.data();
         info.size = game_data.size();
     } else {
-        std::string basename = get_base_name(path);
-        temp_file = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "tmp";
-        helper::mkdir(temp_file);
-        temp_file = temp_file + PATH_SEPARATOR_CHAR + basename + "." + ext;
-        if (!helper::write_file(temp_file, data)) {
-            remove(temp_file.c_str());
-            temp_file.clear();
-            return false;
-        }
+        bool ok = create_temp_file(path, ext, [&data](const content_writer &write) {
+            return write(data.data(), data.size());
+        });
+        /* content lives in temp file now, do not keep a second copy while game runs */
+        data.clear();
+        data.shrink_to_fit();
+        if (!ok) return false;
         info.path = temp_file.c_str();
     }
     if (!core->retro_load_game(&info)) {
@@ -225,27 +319,74 @@ bool driver_base::load_game_from_mem(const std::string &path, const std::string
     return true;
 }
 
+bool driver_base::load_game_from_archive(const std::string &path, const std::string &entry, const std::string &ext) {
+    if (!need_fullpath) return load_game(path, entry);
+    mz_zip_archive arc = {};
+    if (!mz_zip_reader_init_file(&arc, path.c_str(), 0)) {
+        LOG(ERROR, "Unable to open {}", path);
+        return false;
+    }
+    /* inflate straight into temp file, so that content is never held in memory twice */
+    bool ok = create_temp_file(path, ext, [&arc, &entry](const content_writer &write) {
+        return mz_zip_reader_extract_file_to_callback(&arc, entry.c_str(),
+            [](void *opaque, mz_uint64, const void *buf, size_t n) -> size_t {
+                return (*static_cast<const content_writer*>(opaque))(buf, n) ? n : 0;
+            }, const_cast<content_writer*>(&write), 0);
+    });
+    mz_zip_reader_end(&arc);
+    if (!ok) {
+        LOG(ERROR, "Unable to extract {} from {}", entry, path);
+        return false;
+    }
+    retro_game_info info = {};
+    info.path = temp_file.c_str();
+    if (!core->retro_load_game(&info)) {
+        LOG(ERROR, "The core was unable to load {}", path);
+        return false;
+    }
+
+    game_path = path;
+    post_load();
+    return true;
+}
+
 void driver_base::unload_game() {
     shutdown_driver = false;
     check_save_ram();
+    /* stop tracking before core frees its memory */
+    save_persist->clear();
+    rtc_persist->clear();
     core->retro_unload_game();
+    /* pointers in memory maps are not valid any more */
+    memory_map->clear();
+    cheat_finder->clear();
+    cheats->clear();
+    /* files written by core are on storage before next game or exit */
+    libretro::async_writer_obj.wait_all();
     audio->stop();
     video->deinit_hw_renderer();
     unload();
 
+    /* core may keep using game data until retro_unload_game() */
+    if (game_mapping) game_mapping->close();
+    game_data.clear();
+    game_data.shrink_to_fit();
     if (!temp_file.empty()) {
         remove(temp_file.c_str());
         temp_file.clear();
     }
+#ifdef __linux__
+    if (temp_fd >= 0) {
+        ::close(temp_fd);
+        temp_fd = -1;
+    }
+#endif
 
     game_path.clear();
     game_base_name.clear();
     game_save_path.clear();
     game_rtc_path.clear();
-    save_data.clear();
-    rtc_data.clear();
-    check_save_progress = 0;
-    check_rtc_progress = 0;
+    game_cheat_path.clear();
 
     serialization_quirks = 0;
 }
@@ -426,10 +567,11 @@ bool driver_base::env_callback(unsigned cmd, void *data) {
             return true;
         }
         case RETRO_ENVIRONMENT_SET_MEMORY_MAPS: {
-            const auto *memmap = (const retro_memory_map*)data;
-            for (unsigned i = 0; i < memmap->num_descriptors; ++i) {
-                /* TODO: store info of memory map for future use */
+            /* cores may send maps again on bank switches, page tables are rebuilt each time */
+            if (!memory_map->set((const retro_memory_map*)data)) {
+                LOG(WARN, "memory map: no valid descriptors from core");
             }
+            cheats->invalidate();
             return true;
         }
         case RETRO_ENVIRONMENT_SET_GEOMETRY: {
@@ -495,7 +637,8 @@ bool driver_base::env_callback(unsigned cmd, void *data) {
         case RETRO_ENVIRONMENT_GET_VFS_INTERFACE: {
             auto *info = (struct retro_vfs_interface_info *)data;
             if (info->required_interface_version > 3) return false;
-            info->iface = &libretro::vfs_interface;
+            info->iface = &libretro::vfs_core_interface;
+            core_uses_vfs = true;
             return true;
         }
         case RETRO_ENVIRONMENT_GET_LED_INTERFACE:
@@ -584,6 +727,20 @@ void driver_base::save_variables_to_cfg() {
     variables->save_variables_to_cfg(core_cfg_path);
 }
 
+void driver_base::update_cheats() {
+    cheats->apply_codes(core->retro_cheat_reset, core->retro_cheat_set);
+    cheats->invalidate();
+    cheats->save(game_cheat_path);
+}
+
+void driver_base::get_memory_regions(std::vector<libretro::memory_region> &regions) const {
+    memory_map->get_ram_regions(regions);
+    if (!regions.empty() || !core) return;
+    auto *data = static_cast<uint8_t*>(core->retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM));
+    auto size = core->retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM);
+    if (data && size) regions.push_back({data, size, 0});
+}
+
 bool driver_base::load_core(const std::string &path) {
     core = core_load(path.c_str());
     if (!core) return false;
@@ -603,6 +760,8 @@ bool driver_base::load_core(const std::string &path) {
     core_cfg_path += PATH_SEPARATOR_CHAR + name + ".json";
     core_save_dir = save_dir + PATH_SEPARATOR_CHAR + name;
     helper::mkdir(core_save_dir);
+    core_cheat_dir = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "cheats" PATH_SEPARATOR_CHAR + name;
+    helper::mkdir(core_cheat_dir, true);
 
     init_internal();
     return true;
@@ -634,11 +793,13 @@ void driver_base::deinit_internal() {
     if (!inited) return;
 
     core->retro_deinit();
+    libretro::async_writer_obj.wait_all();
 
     /* reset all variables to default value */
     library_name.clear();
     library_version.clear();
     need_fullpath = false;
+    core_uses_vfs = false;
 
     pixel_format = 0;
     support_no_game = false;
@@ -649,38 +810,27 @@ void driver_base::deinit_internal() {
     max_height = 0;
     aspect_ratio = 0.f;
 
-    game_data.clear();
-
     variables->reset();
+    memory_map->clear();
 
     inited = false;
 }
 
-void driver_base::check_save_ram() {
-    check_single_ram(RETRO_MEMORY_SAVE_RAM, save_data, game_save_path, check_save_progress);
-    check_single_ram(RETRO_MEMORY_RTC, rtc_data, game_rtc_path, check_rtc_progress);
-}
-
-void driver_base::check_single_ram(unsigned int id, std::vector<uint8_t> &data, const std::string &filename, size_t &pos) {
+void driver_base::load_single_ram(unsigned id, const std::string &filename, sram_persist &persist) {
+    void *ram = core->retro_get_memory_data(id);
     size_t size = core->retro_get_memory_size(id);
-    if (size) {
-        void *ram = core->retro_get_memory_data(id);
-        if (size != data.size()) {
-            data.resize(size, 0);
-            if (size <= pos) pos = 0;
-        }
-        size_t check_size = (pos + 65536) > size ? size - pos : 65536;
-        LOG(TRACE, "Checking RAM block {}: from 0x{:x}, length 0x{:x}/0x{:x}", id, pos, check_size, size);
-        if (memcmp((uint8_t*)ram + pos, data.data() + pos, check_size) == 0) {
-            pos += check_size;
-            if (pos >= size) pos = 0;
-            return;
-        }
-        pos = 0;
-        LOG(TRACE, "RAM changed, saving to {}", filename);
-        data.assign((uint8_t*)ram, (uint8_t*)ram + size);
-        helper::write_file(filename, data);
+    /* wait for file written by previous game session */
+    libretro::async_writer_obj.wait(filename);
+    std::vector<uint8_t> data;
+    if (ram && size && helper::read_file(filename, data)) {
+        memcpy(ram, data.data(), std::min(size, data.size()));
     }
+    persist.reset(filename, ram, size, fps, g_cfg.get_sram_write_tracking());
+}
+
+void driver_base::check_save_ram() {
+    save_persist->flush(core->retro_get_memory_data(RETRO_MEMORY_SAVE_RAM), core->retro_get_memory_size(RETRO_MEMORY_SAVE_RAM));
+    rtc_persist->flush(core->retro_get_memory_data(RETRO_MEMORY_RTC), core->retro_get_memory_size(RETRO_MEMORY_RTC));
 }
 
 void driver_base::post_load() {
@@ -692,18 +842,13 @@ void driver_base::post_load() {
     game_save_path = (core_save_dir.empty() ? "" : (core_save_dir + PATH_SEPARATOR_CHAR)) + game_base_name + ".sav";
     game_rtc_path = (core_save_dir.empty() ? "" : (core_save_dir + PATH_SEPARATOR_CHAR)) + game_base_name + ".rtc";
 
-    helper::read_file(game_save_path, save_data);
-    helper::read_file(game_rtc_path, rtc_data);
+    load_single_ram(RETRO_MEMORY_SAVE_RAM, game_save_path, *save_persist);
+    load_single_ram(RETRO_MEMORY_RTC, game_rtc_path, *rtc_persist);
 
-    if (!save_data.empty()) {
-        size_t sz = core->retro_get_memory_size(RETRO_MEMORY_SAVE_RAM);
-        if (sz > save_data.size()) sz = save_data.size();
-        if (sz) memcpy(core->retro_get_memory_data(RETRO_MEMORY_SAVE_RAM), save_data.data(), sz);
-    }
-    if (!rtc_data.empty()) {
-        size_t sz = core->retro_get_memory_size(RETRO_MEMORY_RTC);
-        if (sz > rtc_data.size()) sz = rtc_data.size();
-        if (sz) memcpy(core->retro_get_memory_data(RETRO_MEMORY_RTC), rtc_data.data(), sz);
+    game_cheat_path = core_cheat_dir + PATH_SEPARATOR_CHAR + game_base_name + ".cht";
+    if (cheats->load(game_cheat_path)) {
+        LOG(INFO, "Loaded {} cheats from {}", cheats->get_cheats().size(), game_cheat_path);
+        cheats->apply_codes(core->retro_cheat_reset, core->retro_cheat_set);
     }
 
     audio->start(g_cfg.get_mono_audio(), sample_rate, g_cfg.get_sample_rate(), fps);
@@ -14,6 +14,14 @@ struct retro_disk_control_ext_callback;
 
 namespace libretro {
 class retro_variables;
+class memory_map;
+class cheat_search;
+class cheat_engine;
+struct memory_region;
+}
+
+namespace helper {
+class mapped_file;
 }
 
 namespace drivers {
@@ -22,6 +30,7 @@ class video_base;
 class audio_base;
 class input_base;
 class throttle;
+class sram_persist;
 
 enum {
     input_scene_menu = 0,
@@ -44,11 +53,17 @@ public:
     /* shutdown the driver */
     inline void shutdown() { shutdown_driver = true; }
 
-    /* load game from file with given path */
-    bool load_game(const std::string &path);
+    /* load game from file with given path,
+     * or from `entry` inside zip archive `path` through archive VFS */
+    bool load_game(const std::string &path, const std::string &entry = std::string());
 
-    /* load game from memory, use temp file if mem load is not supported */
-    bool load_game_from_mem(const std::string &path, const std::string &ext, const std::vector<uint8_t> &data);
+    /* load game from memory, use temp file if mem load is not supported,
+     * data is moved into driver and kept until unload_game(), or freed once written to temp file */
+    bool load_game_from_mem(const std::string &path, const std::string &ext, std::vector<uint8_t> &&data);
+
+    /* load `entry` inside zip archive `path`, it is inflated into temp file for fullpath cores,
+     * otherwise read through archive VFS like load_game() */
+    bool load_game_from_archive(const std::string &path, const std::string &entry, const std::string &ext);
 
     /* unload game */
     void unload_game();
@@ -61,27 +76,47 @@ public:
     void save_variables_to_cfg();
 
     inline const std::string &get_system_dir() const { return system_dir; }
+    inline bool get_need_fullpath() const { return need_fullpath; }
+    /* core requested VFS interface, so it is able to read files inside archives */
+    inline bool get_core_uses_vfs() const { return core_uses_vfs; }
 
     inline throttle *get_frame_throttle() { return frame_throttle.get(); }
     inline video_base *get_video() { return video.get(); }
     inline audio_base *get_audio() { return audio.get(); }
     inline input_base *get_input() { return input.get(); }
     inline libretro::retro_variables *get_variables() { return variables.get(); }
+    /* memory maps set by core, empty if core does not provide them */
+    inline const libretro::memory_map *get_memory_map() const { return memory_map.get(); }
+    inline libretro::cheat_search *get_cheat_search() { return cheat_finder.get(); }
+    inline libretro::cheat_engine *get_cheats() { return cheats.get(); }
+    /* pass cheat codes to core and rebuild RAM writes after cheats changed, and save cheat file */
+    void update_cheats();
+    /* RAM regions of core for cheat search and cheats, system RAM descriptors of memory maps if any,
+     * otherwise system RAM at address 0, same as RetroArch */
+    void get_memory_regions(std::vector<libretro::memory_region> &regions) const;
 
     /* load core from path */
     bool load_core(const std::string &path);
 
     /* process events, for menu use, return true for QUIT event */
     virtual bool process_events() { return false; }
+    /* wait up to `timeout` ms for an event, then process events like process_events() */
+    virtual bool wait_events(uint32_t timeout) { return process_events(); }
 
 private:
     /* internal init/deinit */
     bool init_internal();
     void deinit_internal();
 
+    /* load sram/rtc from file, and start tracking changes of it */
+    void load_single_ram(unsigned id, const std::string &filename, sram_persist &persist);
     /* check sram/rtc and save to file if changed */
     void check_save_ram();
-    void check_single_ram(unsigned id, std::vector<uint8_t> &data, const std::string &filename, size_t &pos);
+
+    /* writes next piece of content, return false on error */
+    using content_writer = std::function<bool(const void*, size_t)>;
+    /* create temp file `temp_file` for fullpath cores, `fill` writes content through the writer given */
+    bool create_temp_file(const std::string &path, const std::string &ext, const std::function<bool(const content_writer&)> &fill);
 
     /* post processing for game load */
     void post_load();
@@ -116,9 +151,12 @@ protected:
     std::string library_name;
     std::string library_version;
     bool need_fullpath = false;
+    bool core_uses_vfs = false;
 
     /* save_dir + '/' + lower-cased library_name */
     std::string core_save_dir;
+    /* `store_dir`/cheats/ + lower-cased library_name */
+    std::string core_cheat_dir;
 
     /* all variables copied from retro_system_av_info */
     unsigned base_width = 0;    /* Nominal video width of game. */
@@ -149,6 +187,15 @@ protected:
     /* varaibles */
     std::unique_ptr<libretro::retro_variables> variables;
 
+    /* memory maps from RETRO_ENVIRONMENT_SET_MEMORY_MAPS */
+    std::unique_ptr<libretro::memory_map> memory_map;
+
+    /* RAM search state, kept between in-game menu calls */
+    std::unique_ptr<libretro::cheat_search> cheat_finder;
+
+    /* cheats of current game, RAM cheats are applied after each retro_run() */
+    std::unique_ptr<libretro::cheat_engine> cheats;
+
     /* menu button was pressed */
     bool menu_button_pressed = false;
 
@@ -167,21 +214,20 @@ private:
     /* game save/rtc path */
     std::string game_save_path;
     std::string game_rtc_path;
+    std::string game_cheat_path;
 
-    /* game data */
-    std::string game_data;
+    /* game data, either a read-only mapping of rom file or a buffer with file/unzipped content */
+    std::unique_ptr<helper::mapped_file> game_mapping;
+    std::vector<uint8_t> game_data;
 
-    /* temp file for unzip, would be removed after gameplay */
+    /* temp file for unzip, would be removed after gameplay,
+     * on Linux it is a symlink to memfd `temp_fd` holding the content */
     std::string temp_file;
+    int temp_fd = -1;
 
-    /* save&rtc data and checking progress */
-    std::vector<uint8_t> save_data;
-    std::vector<uint8_t> rtc_data;
-    size_t check_save_progress = 0;
-    size_t check_rtc_progress = 0;
-
-    /* frame countdown for save check */
-    uint32_t save_check_countdown = 0;
+    /* save&rtc persistence, checked every frame if save check is enabled */
+    std::unique_ptr<sram_persist> save_persist;
+    std::unique_ptr<sram_persist> rtc_persist;
 
     /* core is inited */
     bool inited = false;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+namespace drivers {
+
+/* detects writes to a memory region by write-protecting its pages,
+ * first write to each page faults into a SIGSEGV handler which marks the page dirty and unprotects it,
+ * so that an unchanged region costs nothing to check.
+ * only available on Linux, and the region must start at a page boundary */
+class page_write_tracker {
+public:
+    page_write_tracker() = default;
+    ~page_write_tracker() { stop(); }
+    page_write_tracker(const page_write_tracker&) = delete;
+    page_write_tracker &operator=(const page_write_tracker&) = delete;
+
+    /* start tracking whole pages from start of `data`,
+     * return number of bytes tracked, which is 0 if not supported */
+    size_t start(void *data, size_t size);
+    /* unprotect all pages and stop tracking */
+    void stop();
+    /* return true if any tracked page was written since last call, and protect written pages again,
+     * tracking is stopped and true is returned if our fault handler was replaced by core */
+    bool collect();
+
+    inline bool active() const { return slot >= 0; }
+
+private:
+    int slot = -1;
+    char *base = nullptr;
+    size_t pages = 0;
+};
+
+}
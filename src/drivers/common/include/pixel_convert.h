@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace drivers {
+
+/* pixel formats follow libretro */
+enum :uint32_t {
+    PIXEL_FORMAT_0RGB1555 = 0,
+    PIXEL_FORMAT_XRGB8888 = 1,
+    PIXEL_FORMAT_RGB565 = 2,
+};
+
+/* convert `count` pixels from `src` to `dst` */
+using pixel_convert_func = void (*)(void *dst, const void *src, size_t count);
+
+/* get converter for the format pair, returns nullptr if formats are the same or not supported */
+pixel_convert_func get_pixel_converter(uint32_t from, uint32_t to);
+
+/* convert a rectangle of pixels line by line, pitches are in bytes */
+void convert_pixels(pixel_convert_func func, void *dst, size_t dst_pitch, const void *src, size_t src_pitch,
+                    int width, int height);
+
+inline uint32_t pixel_format_bytes(uint32_t format) { return format == PIXEL_FORMAT_XRGB8888 ? 4 : 2; }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "page_write_tracker.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace drivers {
+
+/* persists a core memory region (SRAM/RTC) to file,
+ * changes are detected by hashing 4KB pages instead of comparing with a shadow copy,
+ * or by page_write_tracker for page-aligned part of the region if `track_writes` is set,
+ * and saved through libretro::async_writer_obj once the region stops changing */
+class sram_persist {
+public:
+    /* set target file, and take current content of memory as saved,
+     * `fps` is rate of check() calls, which decides pages hashed per call */
+    void reset(const std::string &filename, void *data, size_t size, double fps, bool track_writes = false);
+    /* clear target file and hashes */
+    void clear();
+
+    /* hash next pages of memory, called every frame,
+     * save changes after memory is unchanged for a while, or `max_delay` usecs after first change */
+    void check(void *data, size_t size, uint64_t now, uint64_t max_delay);
+    /* save now if memory changed since last save */
+    void flush(void *data, size_t size);
+
+private:
+    /* hash pages from `first` to `last`, return true if any of them changed */
+    bool hash_pages(const uint8_t *mem, size_t first, size_t last);
+    /* collect written pages from tracker, fall back to hashing if tracking stopped */
+    bool collect_tracked(const uint8_t *mem);
+    /* pages hashed per check(), to cover hashed part a few times within debounce window */
+    void update_check_pages();
+    void save(const void *data, size_t size);
+
+    std::string path;
+    std::vector<uint64_t> page_hashes;
+    size_t size = 0;
+    /* pages before `first_hashed` are watched by tracker, next page to be hashed by check() */
+    page_write_tracker tracker;
+    bool track_writes = false;
+    size_t first_hashed = 0;
+    size_t next_page = 0;
+    double fps = 60.;
+    size_t check_pages = 1;
+    /* changes not saved yet, time of first and last detected change */
+    bool dirty = false;
+    uint64_t first_change = 0;
+    uint64_t last_change = 0;
+};
+
+}
@@ -5,6 +5,11 @@
 #include <unordered_map>
 #include <vector>
 #include <array>
+#include <bitset>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 #ifndef USE_STB_TRUETYPE
 extern "C" {
@@ -13,6 +18,10 @@ typedef struct FT_FaceRec_    *FT_Face;
 }
 #endif
 
+namespace helper {
+class mapped_file;
+}
+
 namespace drivers {
 
 struct rect_pack_data;
@@ -28,16 +37,43 @@ protected:
         uint8_t advW;
     };
     struct font_info {
+        /* font file is mmapped instead of being read into memory */
+        helper::mapped_file *file = nullptr;
+        int index = 0;
 #ifdef USE_STB_TRUETYPE
         float font_scale = 0.f;
-		void *font = nullptr;
-		std::vector<uint8_t> ttf_buffer;
+        void *font = nullptr;
 #else
         FT_Face face = nullptr;
 #endif
     };
+    /* rasterized glyph which is not packed into atlas yet */
+    struct glyph_bitmap {
+        font_data fd;
+        std::vector<uint8_t> data;
+    };
+    /* glyph table page, covers 256 codepoints of BMP */
+    struct font_page {
+        font_data glyphs[256];
+        std::bitset<256> cached;
+    };
+    /* glyph placed relative to the pen position of first line */
+    struct text_glyph {
+        const font_data *fd;
+        int16_t x, y;
+    };
+    /* laid out string, cached until font or font size changes */
+    struct text_layout {
+        std::string text;
+        std::vector<text_glyph> glyphs;
+        int width = 0;
+        int top = 0, bottom = 0;
+    };
+
 public:
-    ttf_font_base();
+    /* sdf: rasterize glyphs once as signed distance fields at reference size,
+     *      renderer scales them to any font size */
+    explicit ttf_font_base(bool sdf = false);
     virtual ~ttf_font_base();
 
     virtual void set_draw_color(uint8_t r, uint8_t g, uint8_t b) {}
@@ -45,35 +81,93 @@ public:
     void init(int size, uint8_t width = 0);
     void deinit();
     bool add(const std::string& filename, int index = 0);
+    /* load glyph atlas cache from disk and start pre-rasterizing glyphs
+     * used by current language in background,
+     * call this after all fonts are added */
+    void precache();
     void get_char_width_and_height(uint16_t ch, uint8_t &width, int8_t &t, int8_t &b);
+    void get_text_width_and_height(const char *text, int &w, int &t, int &b);
+    /* change font size without re-rasterizing glyphs, only valid in sdf mode */
+    bool set_font_size(int size);
 
     inline int get_font_size() const { return font_size; }
+    inline bool is_sdf() const { return sdf_mode; }
 
 private:
     void new_rect_pack();
+    const font_data *pack_glyph(uint16_t ch, const font_data &metrics, const uint8_t *data);
+    void append_cache_record(uint16_t ch, const font_data &metrics, const uint8_t *data);
+    bool load_disk_cache();
+    void save_disk_cache();
+    void prerender_proc(std::vector<uint16_t> codepoints);
+    void stop_prerender();
+
+    void get_glyph_extent(const font_data *fd, int &t, int &b) const;
+    int get_advance(uint16_t ch, const font_data *fd) const;
+    void clear_layout_cache();
+
+    static bool rasterize(const std::vector<font_info> &fis, uint16_t ch, glyph_bitmap &gb, bool sdf);
+    static void make_distance_field(glyph_bitmap &gb);
 
 protected:
     inline const font_data *get_cache(uint16_t ch) {
-        auto ite = font_cache.find(ch);
-        if (ite != font_cache.end()) return &ite->second;
+        const auto *page = font_pages[ch >> 8u].get();
+        if (page && page->cached[ch & 0xFFu]) {
+            const auto *fd = &page->glyphs[ch & 0xFFu];
+            return fd->advW ? fd : nullptr;
+        }
         return make_cache(ch);
     }
     const font_data *make_cache(uint16_t);
+    /* width: max width of a line, 0 for unlimited
+     * wrap: move to next line when line is full, or stop there */
+    const text_layout &layout_text(const char *text, int width, bool wrap);
     virtual uint8_t *prepare_texture(size_t index, uint16_t x, uint16_t y, uint16_t w, uint16_t h, int &pitch) = 0;
     virtual void finish_texture(uint8_t *data, size_t index, uint16_t x, uint16_t y, uint16_t w, uint16_t h, int pitch) {}
     static uint16_t get_rect_pack_width();
+    /* pixel size which glyphs are rasterized at */
+    inline int get_raster_size() const { return sdf_mode ? sdf_ref_size : font_size; }
+    /* scale from rasterized glyph metrics to font size */
+    inline float get_scale() const { return sdf_mode ? (float)font_size / (float)sdf_ref_size : 1.f; }
 
 protected:
+    enum :int {
+        sdf_ref_size = 32,
+        /* distance range in pixels of reference size, also used as glyph padding */
+        sdf_spread = 4,
+    };
+    const bool sdf_mode;
     int font_size = 16;
     std::vector<font_info> fonts;
-    std::unordered_map<uint16_t, font_data> font_cache;
     uint8_t mono_width = 0;
 
 private:
+    /* direct-indexed glyph table, pages are allocated on demand */
+    std::array<std::unique_ptr<font_page>, 256> font_pages;
     std::vector<rect_pack_data*> rectpack_data;
 #ifndef USE_STB_TRUETYPE
     FT_Library ft_lib = {};
 #endif
+
+    /* combined key of all added font files: path, size, mtime, face index and both ends of content */
+    uint64_t fonts_hash = 0;
+
+    /* serialized glyph records for on-disk atlas cache */
+    std::vector<uint8_t> cache_records;
+    uint32_t cache_count = 0;
+    bool cache_dirty = false;
+    /* disk cache was read for current fonts, glyphs in it are packed */
+    bool cache_loaded = false;
+
+    /* text layouts keyed by hash of string, width and wrap flag */
+    std::unordered_map<uint64_t, text_layout> layout_cache;
+    std::vector<uint16_t> decode_buffer;
+
+    /* background pre-rasterization */
+    std::thread prerender_thread;
+    std::mutex prerender_mutex;
+    std::atomic<bool> prerender_stop {false};
+    std::unordered_map<uint16_t, glyph_bitmap> prerendered;
 };
 
 }
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <cstdint>
 #include <cstdlib>
 
@@ -11,6 +13,20 @@ struct retro_hw_render_callback;
 
 namespace drivers {
 
+/* rendered OSD message, created by video drivers on first draw */
+struct osd_cache {
+    virtual ~osd_cache() = default;
+};
+
+struct osd_message {
+    osd_message(const char *t, uint64_t e): text(t), expire(e) {}
+
+    std::string text;
+    /* message is removed when frame counter reaches this */
+    uint64_t expire;
+    std::unique_ptr<osd_cache> cache;
+};
+
 class video_base {
 public:
     virtual ~video_base() = default;
@@ -51,12 +67,21 @@ public:
 
     void add_message(const char *text, uint32_t frames);
     void message_frame_pass();
+    /* drop rendered messages, should be called when font or surface format changes */
+    void clear_message_cache();
     inline void set_skip_frame() { skip_frame = true; }
     inline void set_aspect_ratio(float ratio) { aspect_ratio = ratio; }
 
+protected:
+    /* messages with shorter duration may stay behind longer ones until they reach front,
+     * so check message_active() when drawing */
+    inline bool message_active(const osd_message &m) const { return m.expire > message_frames; }
+    size_t active_messages() const;
+
 protected:
     bool skip_frame = false;
-    std::vector<std::pair<std::string, uint32_t>> messages;
+    std::deque<osd_message> messages;
+    uint64_t message_frames = 0;
     float aspect_ratio = 0.f;
 };
 
@@ -0,0 +1,144 @@
+#include "page_write_tracker.h"
+
+#ifdef __linux__
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace drivers {
+
+#ifdef __linux__
+
+enum :uint32_t {
+    TRACKER_MAX_REGIONS = 4,
+    /* pages beyond this are left to caller to scan */
+    TRACKER_MAX_PAGES = 256,
+};
+
+/* regions are published to signal handler by storing `end` last, and unpublished by clearing it first */
+struct tracked_region {
+    std::atomic<uintptr_t> start;
+    std::atomic<uintptr_t> end;
+    /* count of write faults since page was last collected, 0 if page is clean and protected */
+    std::atomic<uint8_t> dirty[TRACKER_MAX_PAGES];
+};
+
+static tracked_region regions[TRACKER_MAX_REGIONS];
+static size_t page_size = 0;
+static struct sigaction old_action;
+static bool handler_installed = false;
+
+static void segv_handler(int sig, siginfo_t *info, void *ctx) {
+    auto addr = reinterpret_cast<uintptr_t>(info->si_addr);
+    for (auto &r: regions) {
+        auto end = r.end.load(std::memory_order_acquire);
+        auto start = r.start.load(std::memory_order_relaxed);
+        if (addr < start || addr >= end) continue;
+        size_t page = (addr - start) / page_size;
+        r.dirty[page].fetch_add(1, std::memory_order_relaxed);
+        mprotect(reinterpret_cast<void*>(start + page * page_size), page_size, PROT_READ | PROT_WRITE);
+        return;
+    }
+    /* not our fault, pass it on */
+    if (old_action.sa_flags & SA_SIGINFO) {
+        old_action.sa_sigaction(sig, info, ctx);
+    } else if (old_action.sa_handler == SIG_DFL || old_action.sa_handler == SIG_IGN) {
+        /* restore default action, the faulting instruction runs again and crashes as usual */
+        sigaction(SIGSEGV, &old_action, nullptr);
+    } else {
+        old_action.sa_handler(sig);
+    }
+}
+
+static bool handler_in_place() {
+    struct sigaction current = {};
+    sigaction(SIGSEGV, nullptr, &current);
+    return (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == segv_handler;
+}
+
+size_t page_write_tracker::start(void *data, size_t size) {
+    stop();
+    if (!page_size) page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto addr = reinterpret_cast<uintptr_t>(data);
+    size_t count = std::min<size_t>(size / page_size, TRACKER_MAX_PAGES);
+    if (!data || addr % page_size || !count) return 0;
+
+    if (!handler_installed) {
+        struct sigaction sa = {};
+        sa.sa_sigaction = segv_handler;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGSEGV, &sa, &old_action) != 0) return 0;
+        handler_installed = true;
+    } else if (!handler_in_place()) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < TRACKER_MAX_REGIONS; ++i) {
+        auto &r = regions[i];
+        if (r.end.load(std::memory_order_relaxed)) continue;
+        for (size_t j = 0; j < count; ++j) r.dirty[j].store(0, std::memory_order_relaxed);
+        r.start.store(addr, std::memory_order_relaxed);
+        r.end.store(addr + count * page_size, std::memory_order_release);
+        if (mprotect(data, count * page_size, PROT_READ) != 0) {
+            r.end.store(0, std::memory_order_release);
+            return 0;
+        }
+        slot = static_cast<int>(i);
+        base = static_cast<char*>(data);
+        pages = count;
+        return count * page_size;
+    }
+    return 0;
+}
+
+void page_write_tracker::stop() {
+    if (slot < 0) return;
+    mprotect(base, pages * page_size, PROT_READ | PROT_WRITE);
+    regions[slot].end.store(0, std::memory_order_release);
+    slot = -1;
+    base = nullptr;
+    pages = 0;
+}
+
+bool page_write_tracker::collect() {
+    if (slot < 0) return false;
+    if (!handler_in_place()) {
+        /* core installed its own handler, it would not know about our protected pages */
+        stop();
+        return true;
+    }
+    bool written = false;
+    auto &r = regions[slot];
+    for (size_t i = 0; i < pages; ++i) {
+        auto faults = r.dirty[i].load(std::memory_order_relaxed);
+        if (!faults) continue;
+        written = true;
+        /* re-protect before clearing, so that a write from another thread faults and marks page again,
+         * if it faulted in between, count changed and page may be writable again, leave it for next collect */
+        mprotect(base + i * page_size, page_size, PROT_READ);
+        r.dirty[i].compare_exchange_strong(faults, 0, std::memory_order_relaxed);
+    }
+    return written;
+}
+
+#else
+
+size_t page_write_tracker::start(void*, size_t) {
+    return 0;
+}
+
+void page_write_tracker::stop() {
+}
+
+bool page_write_tracker::collect() {
+    return false;
+}
+
+#endif
+
+}
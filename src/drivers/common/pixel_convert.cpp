@@ -0,0 +1,314 @@
+#include "pixel_convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXEL_CONVERT_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_USE_NEON
+#endif
+
+namespace drivers {
+
+static inline uint16_t pixel_1555_to_565(uint16_t p) {
+    return static_cast<uint16_t>(((p & 0x7FE0u) << 1u) | ((p & 0x0200u) >> 4u) | (p & 0x001Fu));
+}
+
+static inline uint16_t pixel_565_to_1555(uint16_t p) {
+    return static_cast<uint16_t>(((p & 0xFFC0u) >> 1u) | (p & 0x001Fu));
+}
+
+static inline uint32_t pixel_1555_to_8888(uint16_t p) {
+    uint32_t r = (p >> 10u) & 0x1Fu, g = (p >> 5u) & 0x1Fu, b = p & 0x1Fu;
+    return (((r << 3u) | (r >> 2u)) << 16u) | (((g << 3u) | (g >> 2u)) << 8u) | ((b << 3u) | (b >> 2u));
+}
+
+static inline uint32_t pixel_565_to_8888(uint16_t p) {
+    uint32_t r = p >> 11u, g = (p >> 5u) & 0x3Fu, b = p & 0x1Fu;
+    return (((r << 3u) | (r >> 2u)) << 16u) | (((g << 2u) | (g >> 4u)) << 8u) | ((b << 3u) | (b >> 2u));
+}
+
+static inline uint16_t pixel_8888_to_565(uint32_t p) {
+    return static_cast<uint16_t>(((p >> 8u) & 0xF800u) | ((p >> 5u) & 0x07E0u) | ((p >> 3u) & 0x001Fu));
+}
+
+static inline uint16_t pixel_8888_to_1555(uint32_t p) {
+    return static_cast<uint16_t>(((p >> 9u) & 0x7C00u) | ((p >> 6u) & 0x03E0u) | ((p >> 3u) & 0x001Fu));
+}
+
+#define DEFINE_CONVERT_C(NAME, SRC_TYPE, DST_TYPE, FUNC) \
+static void NAME##_c(void *dst, const void *src, size_t count) { \
+    auto *d = static_cast<DST_TYPE*>(dst); \
+    const auto *s = static_cast<const SRC_TYPE*>(src); \
+    for (; count; --count) { \
+        *d++ = FUNC(*s++); \
+    } \
+}
+
+DEFINE_CONVERT_C(convert_1555_565, uint16_t, uint16_t, pixel_1555_to_565)
+DEFINE_CONVERT_C(convert_565_1555, uint16_t, uint16_t, pixel_565_to_1555)
+DEFINE_CONVERT_C(convert_1555_8888, uint16_t, uint32_t, pixel_1555_to_8888)
+DEFINE_CONVERT_C(convert_565_8888, uint16_t, uint32_t, pixel_565_to_8888)
+DEFINE_CONVERT_C(convert_8888_565, uint32_t, uint16_t, pixel_8888_to_565)
+DEFINE_CONVERT_C(convert_8888_1555, uint32_t, uint16_t, pixel_8888_to_1555)
+
+#undef DEFINE_CONVERT_C
+
+#if defined(PIXEL_CONVERT_USE_SSE2)
+
+static inline __m128i load128(const void *p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+static inline void store128(void *p, __m128i v) { _mm_storeu_si128(static_cast<__m128i*>(p), v); }
+
+/* expand 5/6-bit channels in 16-bit lanes to 8 bits */
+static inline __m128i expand5(__m128i c) { return _mm_or_si128(_mm_slli_epi16(c, 3), _mm_srli_epi16(c, 2)); }
+static inline __m128i expand6(__m128i c) { return _mm_or_si128(_mm_slli_epi16(c, 2), _mm_srli_epi16(c, 4)); }
+
+/* 8 pixels of r8/g8/b8 in 16-bit lanes to 8 XRGB8888 pixels */
+static inline void store_8888x8(uint32_t *d, __m128i r, __m128i g, __m128i b) {
+    __m128i lo = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+    store128(d, _mm_unpacklo_epi16(lo, r));
+    store128(d + 4, _mm_unpackhi_epi16(lo, r));
+}
+
+/* pack 32-bit lanes holding 16-bit values, sign-extend first as packs_epi32 saturates */
+static inline __m128i pack_16x8(__m128i a, __m128i b) {
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
+}
+
+static void convert_1555_565(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const __m128i mask_rg = _mm_set1_epi16(0x7FE0);
+    const __m128i mask_gl = _mm_set1_epi16(0x0200);
+    const __m128i mask_b = _mm_set1_epi16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        __m128i v = load128(s);
+        __m128i rg = _mm_slli_epi16(_mm_and_si128(v, mask_rg), 1);
+        __m128i gl = _mm_srli_epi16(_mm_and_si128(v, mask_gl), 4);
+        store128(d, _mm_or_si128(_mm_or_si128(rg, gl), _mm_and_si128(v, mask_b)));
+    }
+    convert_1555_565_c(d, s, count);
+}
+
+static void convert_565_1555(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const __m128i mask_rg = _mm_set1_epi16(static_cast<short>(0xFFC0));
+    const __m128i mask_b = _mm_set1_epi16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        __m128i v = load128(s);
+        store128(d, _mm_or_si128(_mm_srli_epi16(_mm_and_si128(v, mask_rg), 1), _mm_and_si128(v, mask_b)));
+    }
+    convert_565_1555_c(d, s, count);
+}
+
+static void convert_1555_8888(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const __m128i mask5 = _mm_set1_epi16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        __m128i v = load128(s);
+        __m128i r = expand5(_mm_and_si128(_mm_srli_epi16(v, 10), mask5));
+        __m128i g = expand5(_mm_and_si128(_mm_srli_epi16(v, 5), mask5));
+        __m128i b = expand5(_mm_and_si128(v, mask5));
+        store_8888x8(d, r, g, b);
+    }
+    convert_1555_8888_c(d, s, count);
+}
+
+static void convert_565_8888(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const __m128i mask5 = _mm_set1_epi16(0x001F);
+    const __m128i mask6 = _mm_set1_epi16(0x003F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        __m128i v = load128(s);
+        __m128i r = expand5(_mm_srli_epi16(v, 11));
+        __m128i g = expand6(_mm_and_si128(_mm_srli_epi16(v, 5), mask6));
+        __m128i b = expand5(_mm_and_si128(v, mask5));
+        store_8888x8(d, r, g, b);
+    }
+    convert_565_8888_c(d, s, count);
+}
+
+static void convert_8888_565(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    const __m128i mask_r = _mm_set1_epi32(0xF800);
+    const __m128i mask_g = _mm_set1_epi32(0x07E0);
+    const __m128i mask_b = _mm_set1_epi32(0x001F);
+    auto conv = [&](__m128i v) {
+        return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 8), mask_r),
+                                         _mm_and_si128(_mm_srli_epi32(v, 5), mask_g)),
+                            _mm_and_si128(_mm_srli_epi32(v, 3), mask_b));
+    };
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        store128(d, pack_16x8(conv(load128(s)), conv(load128(s + 4))));
+    }
+    convert_8888_565_c(d, s, count);
+}
+
+static void convert_8888_1555(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    const __m128i mask_r = _mm_set1_epi32(0x7C00);
+    const __m128i mask_g = _mm_set1_epi32(0x03E0);
+    const __m128i mask_b = _mm_set1_epi32(0x001F);
+    auto conv = [&](__m128i v) {
+        return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 9), mask_r),
+                                         _mm_and_si128(_mm_srli_epi32(v, 6), mask_g)),
+                            _mm_and_si128(_mm_srli_epi32(v, 3), mask_b));
+    };
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        store128(d, pack_16x8(conv(load128(s)), conv(load128(s + 4))));
+    }
+    convert_8888_1555_c(d, s, count);
+}
+
+#elif defined(PIXEL_CONVERT_USE_NEON)
+
+static inline uint16x8_t expand5(uint16x8_t c) { return vorrq_u16(vshlq_n_u16(c, 3), vshrq_n_u16(c, 2)); }
+static inline uint16x8_t expand6(uint16x8_t c) { return vorrq_u16(vshlq_n_u16(c, 2), vshrq_n_u16(c, 4)); }
+
+static inline void store_8888x8(uint32_t *d, uint16x8_t r, uint16x8_t g, uint16x8_t b) {
+    uint16x8_t lo = vorrq_u16(vshlq_n_u16(g, 8), b);
+    uint16x8x2_t z = vzipq_u16(lo, r);
+    vst1q_u32(d, vreinterpretq_u32_u16(z.val[0]));
+    vst1q_u32(d + 4, vreinterpretq_u32_u16(z.val[1]));
+}
+
+static void convert_1555_565(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const uint16x8_t mask_rg = vdupq_n_u16(0x7FE0);
+    const uint16x8_t mask_gl = vdupq_n_u16(0x0200);
+    const uint16x8_t mask_b = vdupq_n_u16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        uint16x8_t v = vld1q_u16(s);
+        uint16x8_t rg = vshlq_n_u16(vandq_u16(v, mask_rg), 1);
+        uint16x8_t gl = vshrq_n_u16(vandq_u16(v, mask_gl), 4);
+        vst1q_u16(d, vorrq_u16(vorrq_u16(rg, gl), vandq_u16(v, mask_b)));
+    }
+    convert_1555_565_c(d, s, count);
+}
+
+static void convert_565_1555(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const uint16x8_t mask_rg = vdupq_n_u16(0x7FE0);
+    const uint16x8_t mask_b = vdupq_n_u16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        uint16x8_t v = vld1q_u16(s);
+        vst1q_u16(d, vorrq_u16(vandq_u16(vshrq_n_u16(v, 1), mask_rg), vandq_u16(v, mask_b)));
+    }
+    convert_565_1555_c(d, s, count);
+}
+
+static void convert_1555_8888(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const uint16x8_t mask5 = vdupq_n_u16(0x001F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        uint16x8_t v = vld1q_u16(s);
+        uint16x8_t r = expand5(vandq_u16(vshrq_n_u16(v, 10), mask5));
+        uint16x8_t g = expand5(vandq_u16(vshrq_n_u16(v, 5), mask5));
+        uint16x8_t b = expand5(vandq_u16(v, mask5));
+        store_8888x8(d, r, g, b);
+    }
+    convert_1555_8888_c(d, s, count);
+}
+
+static void convert_565_8888(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const uint16x8_t mask5 = vdupq_n_u16(0x001F);
+    const uint16x8_t mask6 = vdupq_n_u16(0x003F);
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        uint16x8_t v = vld1q_u16(s);
+        uint16x8_t r = expand5(vshrq_n_u16(v, 11));
+        uint16x8_t g = expand6(vandq_u16(vshrq_n_u16(v, 5), mask6));
+        uint16x8_t b = expand5(vandq_u16(v, mask5));
+        store_8888x8(d, r, g, b);
+    }
+    convert_565_8888_c(d, s, count);
+}
+
+static void convert_8888_565(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    const uint32x4_t mask_r = vdupq_n_u32(0xF800);
+    const uint32x4_t mask_g = vdupq_n_u32(0x07E0);
+    const uint32x4_t mask_b = vdupq_n_u32(0x001F);
+    auto conv = [&](uint32x4_t v) {
+        return vmovn_u32(vorrq_u32(vorrq_u32(vandq_u32(vshrq_n_u32(v, 8), mask_r),
+                                             vandq_u32(vshrq_n_u32(v, 5), mask_g)),
+                                   vandq_u32(vshrq_n_u32(v, 3), mask_b)));
+    };
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        vst1q_u16(d, vcombine_u16(conv(vld1q_u32(s)), conv(vld1q_u32(s + 4))));
+    }
+    convert_8888_565_c(d, s, count);
+}
+
+static void convert_8888_1555(void *dst, const void *src, size_t count) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    const uint32x4_t mask_r = vdupq_n_u32(0x7C00);
+    const uint32x4_t mask_g = vdupq_n_u32(0x03E0);
+    const uint32x4_t mask_b = vdupq_n_u32(0x001F);
+    auto conv = [&](uint32x4_t v) {
+        return vmovn_u32(vorrq_u32(vorrq_u32(vandq_u32(vshrq_n_u32(v, 9), mask_r),
+                                             vandq_u32(vshrq_n_u32(v, 6), mask_g)),
+                                   vandq_u32(vshrq_n_u32(v, 3), mask_b)));
+    };
+    for (; count >= 8; count -= 8, s += 8, d += 8) {
+        vst1q_u16(d, vcombine_u16(conv(vld1q_u32(s)), conv(vld1q_u32(s + 4))));
+    }
+    convert_8888_1555_c(d, s, count);
+}
+
+#else
+
+#define convert_1555_565 convert_1555_565_c
+#define convert_565_1555 convert_565_1555_c
+#define convert_1555_8888 convert_1555_8888_c
+#define convert_565_8888 convert_565_8888_c
+#define convert_8888_565 convert_8888_565_c
+#define convert_8888_1555 convert_8888_1555_c
+
+#endif
+
+pixel_convert_func get_pixel_converter(uint32_t from, uint32_t to) {
+    switch (from) {
+    case PIXEL_FORMAT_0RGB1555:
+        if (to == PIXEL_FORMAT_RGB565) return convert_1555_565;
+        if (to == PIXEL_FORMAT_XRGB8888) return convert_1555_8888;
+        break;
+    case PIXEL_FORMAT_XRGB8888:
+        if (to == PIXEL_FORMAT_RGB565) return convert_8888_565;
+        if (to == PIXEL_FORMAT_0RGB1555) return convert_8888_1555;
+        break;
+    case PIXEL_FORMAT_RGB565:
+        if (to == PIXEL_FORMAT_0RGB1555) return convert_565_1555;
+        if (to == PIXEL_FORMAT_XRGB8888) return convert_565_8888;
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+void convert_pixels(pixel_convert_func func, void *dst, size_t dst_pitch, const void *src, size_t src_pitch,
+                    int width, int height) {
+    auto *d = static_cast<uint8_t*>(dst);
+    const auto *s = static_cast<const uint8_t*>(src);
+    for (; height > 0; --height) {
+        func(d, s, width);
+        d += dst_pitch;
+        s += src_pitch;
+    }
+}
+
+}
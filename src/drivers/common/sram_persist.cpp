@@ -0,0 +1,126 @@
+#include "sram_persist.h"
+
+#include "logger.h"
+
+#include <async_writer.h>
+
+#include <xxhash.h>
+
+#include <algorithm>
+
+namespace drivers {
+
+enum :uint32_t {
+    SRAM_PAGE_SIZE = 4096,
+    /* save once memory is unchanged for this long (in usecs) */
+    SRAM_SAVE_DEBOUNCE = 1000000,
+    /* times hashed pages are fully covered within debounce window */
+    SRAM_PASSES_PER_DEBOUNCE = 4,
+};
+
+void sram_persist::reset(const std::string &filename, void *data, size_t sz, double frame_rate, bool track) {
+    tracker.stop();
+    path = filename;
+    size = sz;
+    fps = frame_rate;
+    track_writes = track;
+    page_hashes.assign((sz + SRAM_PAGE_SIZE - 1) / SRAM_PAGE_SIZE, 0);
+    /* host pages are multiples of 4KB, tracked part always ends at a hashed page boundary */
+    first_hashed = track && data ? tracker.start(data, sz) / SRAM_PAGE_SIZE : 0;
+    next_page = first_hashed;
+    update_check_pages();
+    dirty = false;
+    if (data) hash_pages(static_cast<const uint8_t*>(data), first_hashed, page_hashes.size());
+}
+
+void sram_persist::clear() {
+    tracker.stop();
+    first_hashed = 0;
+    path.clear();
+    page_hashes.clear();
+    size = 0;
+    next_page = 0;
+    check_pages = 1;
+    dirty = false;
+}
+
+void sram_persist::check(void *data, size_t sz, uint64_t now, uint64_t max_delay) {
+    if (path.empty() || !data || !sz) return;
+    if (sz != size) {
+        /* region resized by core, treat all content as changed */
+        reset(path, data, sz, fps, track_writes);
+        dirty = true;
+        first_change = last_change = now;
+    }
+    const auto *mem = static_cast<const uint8_t*>(data);
+    bool changed = collect_tracked(mem);
+    auto count = page_hashes.size();
+    auto last = std::min<size_t>(next_page + check_pages, count);
+    if (hash_pages(mem, next_page, last)) changed = true;
+    next_page = last >= count ? first_hashed : last;
+    if (changed) {
+        if (!dirty) first_change = now;
+        dirty = true;
+        last_change = now;
+    }
+    if (dirty && (now - last_change >= SRAM_SAVE_DEBOUNCE || now - first_change >= max_delay)) {
+        save(data, sz);
+    }
+}
+
+void sram_persist::flush(void *data, size_t sz) {
+    if (path.empty() || !data || !sz) return;
+    if (sz != size) {
+        reset(path, data, sz, fps, track_writes);
+        dirty = true;
+    } else {
+        const auto *mem = static_cast<const uint8_t*>(data);
+        if (collect_tracked(mem)) dirty = true;
+        if (hash_pages(mem, first_hashed, page_hashes.size())) dirty = true;
+    }
+    if (dirty) save(data, sz);
+}
+
+bool sram_persist::collect_tracked(const uint8_t *mem) {
+    if (!first_hashed) return false;
+    bool written = tracker.collect();
+    if (!tracker.active()) {
+        /* hash formerly tracked pages from now on */
+        hash_pages(mem, 0, first_hashed);
+        first_hashed = 0;
+        next_page = 0;
+        update_check_pages();
+    }
+    return written;
+}
+
+void sram_persist::update_check_pages() {
+    /* a few passes over hashed pages within debounce window are enough to notice it is quiet,
+     * so that typical SRAM sizes hash about one page per frame */
+    auto hashed = page_hashes.size() - first_hashed;
+    auto frames = static_cast<size_t>(fps * SRAM_SAVE_DEBOUNCE / 1000000.0 / SRAM_PASSES_PER_DEBOUNCE);
+    if (frames < 1) frames = 1;
+    check_pages = std::max<size_t>(1, (hashed + frames - 1) / frames);
+}
+
+bool sram_persist::hash_pages(const uint8_t *mem, size_t first, size_t last) {
+    bool changed = false;
+    for (size_t i = first; i < last; ++i) {
+        size_t offset = i * SRAM_PAGE_SIZE;
+        auto hash = XXH3_64bits(mem + offset, std::min<size_t>(SRAM_PAGE_SIZE, size - offset));
+        if (hash != page_hashes[i]) {
+            page_hashes[i] = hash;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void sram_persist::save(const void *data, size_t sz) {
+    LOG(TRACE, "RAM changed, saving to {}", path);
+    const auto *mem = static_cast<const uint8_t*>(data);
+    libretro::async_writer_obj.write(path, std::vector<uint8_t>(mem, mem + sz));
+    dirty = false;
+}
+
+}
@@ -2,19 +2,36 @@
 
 #include "stb_rect_pack.h"
 
+#include <helper.h>
+#include <i18n.h>
+#include <cfg.h>
+#include <logger.h>
+
+#include <xxhash.h>
+
 #ifdef USE_STB_TRUETYPE
 #include "stb_truetype.h"
-#include <helper.h>
-#include <cstring>
 #else
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 namespace drivers {
 
 enum :uint16_t {
-    TTF_RECTPACK_WIDTH = 1024
+    TTF_RECTPACK_WIDTH = 1024,
+    TTF_LAYOUT_CACHE_MAX = 512,
+};
+
+enum :uint32_t {
+    TTF_CACHE_MAGIC = 0x43475253u, /* 'SRGC' */
+    TTF_CACHE_VERSION = 1,
+    /* bytes hashed at both ends of a font file for disk cache key */
+    TTF_CACHE_KEY_SAMPLE = 4096,
 };
 
 struct rect_pack_data {
@@ -22,7 +39,49 @@ struct rect_pack_data {
     stbrp_node nodes[TTF_RECTPACK_WIDTH];
 };
 
-ttf_font_base::ttf_font_base() {
+/* header of serialized glyph record, followed by w*h bytes of bitmap */
+#pragma pack(push, 1)
+struct glyph_record {
+    uint16_t ch;
+    int8_t ix0, iy0;
+    uint8_t w, h;
+    uint8_t advW;
+    uint8_t reserved;
+};
+#pragma pack(pop)
+
+struct glyph_range {
+    uint16_t from, to;
+};
+
+/* glyph ranges to pre-rasterize for languages, indexed by retro_language */
+static const std::vector<glyph_range> language_glyph_ranges[RETRO_LANGUAGE_LAST] = {
+    {},                                                     /* English */
+    {{0x3000, 0x30FF}, {0xFF00, 0xFF60}},                   /* Japanese: punctuations and kana */
+    {{0x00C0, 0x017F}},                                     /* French */
+    {{0x00C0, 0x017F}},                                     /* Spanish */
+    {{0x00C0, 0x017F}},                                     /* German */
+    {{0x00C0, 0x017F}},                                     /* Italian */
+    {{0x00C0, 0x017F}},                                     /* Dutch */
+    {{0x00C0, 0x017F}},                                     /* Portuguese (Brazil) */
+    {{0x00C0, 0x017F}},                                     /* Portuguese (Portugal) */
+    {{0x0400, 0x04FF}},                                     /* Russian */
+    {{0x3000, 0x303F}, {0x3130, 0x318F}, {0xFF00, 0xFF60}}, /* Korean: punctuations and compatibility jamo */
+    {{0x3000, 0x303F}, {0xFF00, 0xFF60}},                   /* Chinese (Traditional) */
+    {{0x3000, 0x303F}, {0xFF00, 0xFF60}},                   /* Chinese (Simplified) */
+    {{0x0100, 0x017F}},                                     /* Esperanto */
+    {{0x0100, 0x017F}},                                     /* Polish */
+    {{0x0100, 0x01B0}, {0x1EA0, 0x1EFF}},                   /* Vietnamese */
+    {{0x0600, 0x06FF}},                                     /* Arabic */
+    {{0x0370, 0x03FF}},                                     /* Greek */
+    {{0x0100, 0x017F}},                                     /* Turkish */
+    {{0x0100, 0x017F}},                                     /* Slovak */
+    {{0x0600, 0x06FF}},                                     /* Persian */
+    {{0x0590, 0x05FF}},                                     /* Hebrew */
+    {{0x00C0, 0x017F}},                                     /* Asturian */
+};
+
+ttf_font_base::ttf_font_base(bool sdf): sdf_mode(sdf) {
 #ifndef USE_STB_TRUETYPE
     FT_Init_FreeType(&ft_lib);
 #endif
@@ -38,10 +97,27 @@ ttf_font_base::~ttf_font_base() {
 void ttf_font_base::init(int size, uint8_t width) {
     font_size = size;
     mono_width = width;
+    clear_layout_cache();
 }
 
 void ttf_font_base::deinit() {
-    font_cache.clear();
+    stop_prerender();
+    clear_layout_cache();
+    /* glyphs rasterized in background but never used still go to disk cache */
+    for (auto &p: prerendered) {
+        append_cache_record(p.first, p.second.fd, p.second.data.data());
+    }
+    prerendered.clear();
+    save_disk_cache();
+    cache_records.clear();
+    cache_count = 0;
+    cache_dirty = false;
+    cache_loaded = false;
+    fonts_hash = 0;
+
+    for (auto &p: font_pages) {
+        p.reset();
+    }
     for (auto *&p: rectpack_data) {
         delete p;
     }
@@ -49,112 +125,254 @@ void ttf_font_base::deinit() {
     for (auto &p: fonts) {
 #ifdef USE_STB_TRUETYPE
         delete static_cast<stbtt_fontinfo *>(p.font);
-		p.ttf_buffer.clear();
 #else
         FT_Done_Face(p.face);
 #endif
+        delete p.file;
     }
     fonts.clear();
 }
 
 bool ttf_font_base::add(const std::string &filename, int index) {
+    stop_prerender();
+    /* glyphs may come from the new font now */
+    clear_layout_cache();
     font_info fi;
-#ifdef USE_STB_TRUETYPE
-    if (!helper::read_file(filename, fi.ttf_buffer)) {
+    fi.file = new helper::mapped_file;
+    if (!fi.file->open(filename)) {
+        delete fi.file;
         return false;
     }
+    fi.index = index;
+    const auto *ttf_data = fi.file->data();
+#ifdef USE_STB_TRUETYPE
     auto *info = new stbtt_fontinfo;
-	stbtt_InitFont(info, &fi.ttf_buffer[0], stbtt_GetFontOffsetForIndex(&fi.ttf_buffer[0], index));
-	fi.font_scale = stbtt_ScaleForMappingEmToPixels(info, static_cast<float>(font_size));
-	fi.font = info;
-    fonts.emplace_back(std::move(fi));
+    if (!stbtt_InitFont(info, ttf_data, stbtt_GetFontOffsetForIndex(ttf_data, index))) {
+        delete info;
+        delete fi.file;
+        return false;
+    }
+    fi.font_scale = stbtt_ScaleForMappingEmToPixels(info, static_cast<float>(get_raster_size()));
+    fi.font = info;
 #else
-    if (FT_New_Face(ft_lib, filename.c_str(), index, &fi.face)) return false;
-    FT_Set_Pixel_Sizes(fi.face, 0, font_size);
-    fonts.emplace_back(fi);
+    if (FT_New_Memory_Face(ft_lib, ttf_data, static_cast<FT_Long>(fi.file->size()), index, &fi.face)) {
+        delete fi.file;
+        return false;
+    }
+    FT_Set_Pixel_Sizes(fi.face, 0, get_raster_size());
 #endif
-    new_rect_pack();
+    /* key disk cache on file identity and both ends of the file,
+     * hashing whole content would fault in every page of a multi-MB font */
+    uint64_t file_size = 0;
+    int64_t mtime = 0;
+    helper::file_stat(filename, file_size, mtime);
+    size_t size = fi.file->size();
+    size_t sample = std::min<size_t>(size, TTF_CACHE_KEY_SAMPLE);
+    uint64_t hashes[7] = {
+        fonts_hash, XXH3_64bits(filename.data(), filename.size()), file_size, static_cast<uint64_t>(mtime),
+        static_cast<uint64_t>(index), XXH3_64bits(ttf_data, sample), XXH3_64bits(ttf_data + size - sample, sample)
+    };
+    fonts_hash = XXH3_64bits(hashes, sizeof(hashes));
+    fonts.emplace_back(fi);
+    if (rectpack_data.empty()) {
+        new_rect_pack();
+    }
     return true;
 }
 
+void ttf_font_base::precache() {
+    if (fonts.empty()) return;
+    stop_prerender();
+    load_disk_cache();
+
+    /* glyphs of localized texts go first as they are shown in menu,
+     * then common ranges of current language */
+    std::vector<uint16_t> codepoints;
+    const auto *texts = libretro::i18n_obj.get_current_texts();
+    if (texts) {
+        for (const auto &p: *texts) {
+            helper::utf8_to_ucs2(p.second.c_str(), p.second.length(), decode_buffer);
+            codepoints.insert(codepoints.end(), decode_buffer.begin(), decode_buffer.end());
+        }
+        std::sort(codepoints.begin(), codepoints.end());
+        codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
+    }
+    auto add_range = [&codepoints](uint16_t from, uint16_t to) {
+        for (uint32_t ch = from; ch <= to; ++ch) {
+            codepoints.push_back(static_cast<uint16_t>(ch));
+        }
+    };
+    add_range(0x20, 0x7E);
+    add_range(0xA0, 0xFF);
+    auto lang = g_cfg.get_language();
+    if (lang >= 0 && lang < RETRO_LANGUAGE_LAST) {
+        for (const auto &r: language_glyph_ranges[lang]) {
+            add_range(r.from, r.to);
+        }
+    }
+
+    /* skip glyphs loaded from disk cache */
+    codepoints.erase(std::remove_if(codepoints.begin(), codepoints.end(), [this](uint16_t ch) {
+        const auto *page = font_pages[ch >> 8u].get();
+        return page && page->cached[ch & 0xFFu];
+    }), codepoints.end());
+    if (codepoints.empty()) return;
+
+    prerender_stop = false;
+    prerender_thread = std::thread(&ttf_font_base::prerender_proc, this, std::move(codepoints));
+}
+
 void ttf_font_base::get_char_width_and_height(uint16_t ch, uint8_t &width, int8_t &t, int8_t &b) {
-    const font_data *fd;
-    auto ite = font_cache.find(ch);
-    if (ite == font_cache.end()) {
-        fd = make_cache(ch);
-        if (!fd) {
-            width = t = b = 0;
-            return;
+    const font_data *fd = get_cache(ch);
+    if (!fd) {
+        width = t = b = 0;
+        return;
+    }
+    int it, ib;
+    get_glyph_extent(fd, it, ib);
+    width = static_cast<uint8_t>(get_advance(ch, fd));
+    t = static_cast<int8_t>(it);
+    b = static_cast<int8_t>(ib);
+}
+
+void ttf_font_base::get_text_width_and_height(const char *text, int &w, int &t, int &b) {
+    const auto &layout = layout_text(text, 0, false);
+    w = layout.width;
+    t = layout.top;
+    b = layout.bottom;
+}
+
+bool ttf_font_base::set_font_size(int size) {
+    if (!sdf_mode) return false;
+    if (size != font_size) {
+        font_size = size;
+        clear_layout_cache();
+    }
+    return true;
+}
+
+const ttf_font_base::text_layout &ttf_font_base::layout_text(const char *text, int width, bool wrap) {
+    size_t len = strlen(text);
+    uint64_t key = XXH3_64bits_withSeed(text, len, (static_cast<uint64_t>(width) << 1u) | (wrap ? 1u : 0u));
+    auto ite = layout_cache.find(key);
+    if (ite != layout_cache.end() && ite->second.text.length() == len && memcmp(ite->second.text.c_str(), text, len) == 0) {
+        return ite->second;
+    }
+    if (layout_cache.size() >= TTF_LAYOUT_CACHE_MAX) {
+        clear_layout_cache();
+    }
+    auto &layout = layout_cache[key];
+    layout.text.assign(text, len);
+    layout.glyphs.clear();
+    layout.width = 0;
+    layout.top = 255;
+    layout.bottom = -255;
+
+    helper::utf8_to_ucs2(text, len, decode_buffer);
+    int x = 0, y = 0;
+    for (auto ch: decode_buffer) {
+        const font_data *fd = get_cache(ch);
+        if (!fd) continue;
+        int advance = get_advance(ch, fd);
+        if (width > 0 && x + advance > width) {
+            if (!wrap) break;
+            if (x > 0) {
+                x = 0;
+                y += font_size + 1;
+            }
         }
-    } else {
-        fd = &ite->second;
-        if (fd->advW == 0) {
-            width = t = b = 0;
-            return;
+        layout.glyphs.push_back({fd, static_cast<int16_t>(x), static_cast<int16_t>(y)});
+        if (advance) {
+            int t, b;
+            get_glyph_extent(fd, t, b);
+            if (t < layout.top) layout.top = t;
+            if (b > layout.bottom) layout.bottom = b;
         }
+        x += advance;
+        if (x > layout.width) layout.width = x;
+    }
+    return layout;
+}
+
+void ttf_font_base::get_glyph_extent(const font_data *fd, int &t, int &b) const {
+    if (sdf_mode) {
+        /* strip padding of distance field and scale to font size */
+        float scale = get_scale();
+        int pad = fd->h ? sdf_spread : 0;
+        t = static_cast<int>(std::floor(static_cast<float>(fd->iy0 + pad) * scale));
+        b = static_cast<int>(std::ceil(static_cast<float>(fd->iy0 + fd->h - pad) * scale));
+        return;
     }
-    if (mono_width)
-        width = std::max(fd->advW, mono_width);
-    else
-        width = fd->advW;
     t = fd->iy0;
     b = fd->iy0 + fd->h;
 }
 
+int ttf_font_base::get_advance(uint16_t ch, const font_data *fd) const {
+    int advance = sdf_mode ? static_cast<int>(std::lround(static_cast<float>(fd->advW) * get_scale())) : fd->advW;
+    if (mono_width) {
+        /* wide characters take double width */
+        advance = std::max(advance, ch < (1u << 12u) ? mono_width : mono_width * 2);
+    }
+    return advance;
+}
+
+void ttf_font_base::clear_layout_cache() {
+    layout_cache.clear();
+}
+
 const ttf_font_base::font_data *ttf_font_base::make_cache(uint16_t ch) {
-    font_info *fi = nullptr;
-#ifdef USE_STB_TRUETYPE
-    stbtt_fontinfo *info;
-    uint32_t index = 0;
-#endif
-    for (auto &f: fonts) {
-        fi = &f;
-#ifdef USE_STB_TRUETYPE
-        info = static_cast<stbtt_fontinfo*>(f.font);
-        index = stbtt_FindGlyphIndex(info, ch);
-        if (index == 0) continue;
-#else
-        auto index = FT_Get_Char_Index(f.face, ch);
-        if (index == 0) continue;
-        if (!FT_Load_Glyph(f.face, index, FT_LOAD_DEFAULT)) break;
-#endif
+    /* fonts never precached read disk cache on first miss */
+    if (!cache_loaded && load_disk_cache()) {
+        const auto *page = font_pages[ch >> 8u].get();
+        if (page && page->cached[ch & 0xFFu]) {
+            const auto *fd = &page->glyphs[ch & 0xFFu];
+            return fd->advW ? fd : nullptr;
+        }
     }
-    font_data *fd = &font_cache[ch];
-    if (fi == nullptr) {
-        memset(fd, 0, sizeof(font_data));
-        return nullptr;
+    glyph_bitmap gb;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lk(prerender_mutex);
+        auto ite = prerendered.find(ch);
+        if (ite != prerendered.end()) {
+            gb = std::move(ite->second);
+            prerendered.erase(ite);
+            found = true;
+        }
     }
+    if (!found) {
+        rasterize(fonts, ch, gb, sdf_mode);
+    }
+    append_cache_record(ch, gb.fd, gb.data.data());
+    return pack_glyph(ch, gb.fd, gb.data.data());
+}
 
-#ifdef USE_STB_TRUETYPE
-    /* Read font data to cache */
-    int advW, leftB;
-    stbtt_GetGlyphHMetrics(info, index, &advW, &leftB);
-    fd->advW = static_cast<uint8_t>(fi->font_scale * advW);
-    leftB = static_cast<uint8_t>(fi->font_scale * leftB);
-    int ix0, iy0, ix1, iy1;
-    stbtt_GetGlyphBitmapBoxSubpixel(info, index, fi->font_scale, fi->font_scale, 3, 3, &ix0, &iy0, &ix1, &iy1);
-    fd->ix0 = leftB;
-    fd->iy0 = iy0;
-    fd->w = ix1 - ix0;
-    fd->h = iy1 - iy0;
-#else
-    unsigned char *src_ptr;
-    int bitmap_pitch;
-    if (FT_Render_Glyph(fi->face->glyph, FT_RENDER_MODE_NORMAL)) return nullptr;
-    FT_GlyphSlot slot = fi->face->glyph;
-    fd->ix0 = slot->bitmap_left;
-    fd->iy0 = -slot->bitmap_top;
-    fd->w = slot->bitmap.width;
-    fd->h = slot->bitmap.rows;
-    fd->advW = slot->advance.x >> 6;
-    src_ptr = slot->bitmap.buffer;
-    bitmap_pitch = slot->bitmap.pitch;
-#endif
+const ttf_font_base::font_data *ttf_font_base::pack_glyph(uint16_t ch, const font_data &metrics, const uint8_t *data) {
+    auto &page = font_pages[ch >> 8u];
+    if (!page) {
+        page = std::make_unique<font_page>();
+    }
+    page->cached.set(ch & 0xFFu);
+    font_data *fd = &page->glyphs[ch & 0xFFu];
+    memset(fd, 0, sizeof(font_data));
+    if (metrics.advW == 0) {
+        return nullptr;
+    }
+    fd->ix0 = metrics.ix0;
+    fd->iy0 = metrics.iy0;
+    fd->w = metrics.w;
+    fd->h = metrics.h;
+    fd->advW = metrics.advW;
+    if (fd->w == 0 || fd->h == 0) {
+        return fd;
+    }
 
     /* Get last rect pack bitmap */
     auto rpidx = rectpack_data.size() - 1;
     auto *rpd = rectpack_data[rpidx];
-    stbrp_rect rc = {0, static_cast<uint16_t>((fd->w + 3u) & ~3u), fd->h};
+    /* distance fields are sampled with linear filter, keep a gap between glyphs */
+    int gap = sdf_mode ? 1 : 0;
+    stbrp_rect rc = {0, static_cast<uint16_t>((fd->w + gap + 3u) & ~3u), static_cast<uint16_t>(fd->h + gap)};
     if (!stbrp_pack_rects(&rpd->context, &rc, 1)) {
         /* No space to hold the bitmap,
          * create a new bitmap */
@@ -171,19 +389,258 @@ const ttf_font_base::font_data *ttf_font_base::make_cache(uint16_t ch) {
     int dst_pitch;
     auto *dst = prepare_texture(rpidx, rc.x, rc.y, rc.w, rc.h, dst_pitch);
     auto *dst_ptr = dst;
-#ifdef USE_STB_TRUETYPE
-    stbtt_MakeGlyphBitmapSubpixel(info, dst, fd->w, fd->h, dst_pitch, fi->font_scale, fi->font_scale, 3, 3, index);
-#else
     for (int k = 0; k < fd->h; ++k) {
-        memcpy(dst_ptr, src_ptr, fd->w);
-        src_ptr += bitmap_pitch;
+        memcpy(dst_ptr, data, fd->w);
+        data += fd->w;
         dst_ptr += dst_pitch;
     }
-#endif
     finish_texture(dst, rpidx, rc.x, rc.y, rc.w, rc.h, dst_pitch);
     return fd;
 }
 
+void ttf_font_base::append_cache_record(uint16_t ch, const font_data &metrics, const uint8_t *data) {
+    glyph_record rec = {ch, metrics.ix0, metrics.iy0, metrics.w, metrics.h, metrics.advW, 0};
+    size_t bitmap_size = metrics.advW ? metrics.w * metrics.h : 0;
+    if (!bitmap_size) rec.w = rec.h = 0;
+    auto pos = cache_records.size();
+    cache_records.resize(pos + sizeof(glyph_record) + bitmap_size);
+    memcpy(&cache_records[pos], &rec, sizeof(glyph_record));
+    if (bitmap_size) memcpy(&cache_records[pos + sizeof(glyph_record)], data, bitmap_size);
+    ++cache_count;
+    cache_dirty = true;
+}
+
+static std::string get_disk_cache_path(uint64_t hash, int size, uint8_t mono_width, bool sdf) {
+    char filename[64];
+    if (sdf)
+        snprintf(filename, 64, "font_%016llx_%d_sdf.cache", static_cast<unsigned long long>(hash), size);
+    else
+        snprintf(filename, 64, "font_%016llx_%d_%u.cache", static_cast<unsigned long long>(hash), size, mono_width);
+    return g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "cache" PATH_SEPARATOR_CHAR + filename;
+}
+
+bool ttf_font_base::load_disk_cache() {
+    if (cache_loaded) return cache_count > 0;
+    cache_loaded = true;
+    std::vector<uint8_t> content;
+    if (!helper::read_file(get_disk_cache_path(fonts_hash, get_raster_size(), mono_width, sdf_mode), content)) {
+        return false;
+    }
+    if (content.size() < 16) return false;
+    uint32_t header[2];
+    uint64_t hash;
+    memcpy(header, &content[0], 8);
+    memcpy(&hash, &content[8], 8);
+    if (header[0] != TTF_CACHE_MAGIC || header[1] != TTF_CACHE_VERSION || hash != fonts_hash) {
+        return false;
+    }
+    /* glyphs rasterized before loading are already packed and recorded, their records in file are dropped */
+    std::vector<uint8_t> records;
+    size_t pos = 16;
+    size_t size = content.size();
+    uint32_t count = 0;
+    while (pos + sizeof(glyph_record) <= size) {
+        glyph_record rec;
+        memcpy(&rec, &content[pos], sizeof(glyph_record));
+        size_t record_size = sizeof(glyph_record) + rec.w * rec.h;
+        if (pos + record_size > size) break;
+        const auto *page = font_pages[rec.ch >> 8u].get();
+        if (!page || !page->cached[rec.ch & 0xFFu]) {
+            font_data fd = {0, 0, 0, rec.ix0, rec.iy0, rec.w, rec.h, rec.advW};
+            pack_glyph(rec.ch, fd, &content[pos + sizeof(glyph_record)]);
+            records.insert(records.end(), content.begin() + pos, content.begin() + pos + record_size);
+            ++count;
+        }
+        pos += record_size;
+    }
+    records.insert(records.end(), cache_records.begin(), cache_records.end());
+    cache_records = std::move(records);
+    cache_count += count;
+    LOG(TRACE, "Loaded {} glyphs from font cache", count);
+    return true;
+}
+
+void ttf_font_base::save_disk_cache() {
+    if (!cache_dirty || fonts.empty()) return;
+    /* merge with glyphs in file, or they are lost when file is rewritten */
+    load_disk_cache();
+    auto path = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR "cache";
+    helper::mkdir(path);
+    std::vector<uint8_t> content(16);
+    uint32_t header[2] = {TTF_CACHE_MAGIC, TTF_CACHE_VERSION};
+    memcpy(&content[0], header, 8);
+    memcpy(&content[8], &fonts_hash, 8);
+    content.insert(content.end(), cache_records.begin(), cache_records.end());
+    helper::write_file(get_disk_cache_path(fonts_hash, get_raster_size(), mono_width, sdf_mode), content);
+    cache_dirty = false;
+}
+
+void ttf_font_base::prerender_proc(std::vector<uint16_t> codepoints) {
+#ifdef USE_STB_TRUETYPE
+    /* stb_truetype does not modify font info while rasterizing,
+     * so we can share them with main thread */
+    const auto &fis = fonts;
+#else
+    /* FreeType faces are not thread-safe, open our own ones */
+    FT_Library lib;
+    if (FT_Init_FreeType(&lib)) return;
+    std::vector<font_info> fis;
+    for (auto &f: fonts) {
+        font_info fi;
+        if (FT_New_Memory_Face(lib, f.file->data(), static_cast<FT_Long>(f.file->size()), f.index, &fi.face)) continue;
+        FT_Set_Pixel_Sizes(fi.face, 0, get_raster_size());
+        fis.emplace_back(fi);
+    }
+#endif
+    for (auto ch: codepoints) {
+        if (prerender_stop) break;
+        glyph_bitmap gb;
+        rasterize(fis, ch, gb, sdf_mode);
+        std::lock_guard<std::mutex> lk(prerender_mutex);
+        prerendered.emplace(ch, std::move(gb));
+    }
+#ifndef USE_STB_TRUETYPE
+    for (auto &fi: fis) {
+        FT_Done_Face(fi.face);
+    }
+    FT_Done_FreeType(lib);
+#endif
+}
+
+void ttf_font_base::stop_prerender() {
+    if (!prerender_thread.joinable()) return;
+    prerender_stop = true;
+    prerender_thread.join();
+    /* glyphs already packed by main thread while rendering */
+    for (auto ite = prerendered.begin(); ite != prerendered.end();) {
+        const auto *page = font_pages[ite->first >> 8u].get();
+        if (page && page->cached[ite->first & 0xFFu]) {
+            ite = prerendered.erase(ite);
+        } else {
+            ++ite;
+        }
+    }
+}
+
+bool ttf_font_base::rasterize(const std::vector<font_info> &fis, uint16_t ch, glyph_bitmap &gb, bool sdf) {
+    memset(&gb.fd, 0, sizeof(font_data));
+    gb.data.clear();
+    for (const auto &f: fis) {
+#ifdef USE_STB_TRUETYPE
+        auto *info = static_cast<stbtt_fontinfo*>(f.font);
+        int index = stbtt_FindGlyphIndex(info, ch);
+        if (index == 0) continue;
+
+        int advW, leftB;
+        stbtt_GetGlyphHMetrics(info, index, &advW, &leftB);
+        int ix0, iy0, ix1, iy1;
+        stbtt_GetGlyphBitmapBoxSubpixel(info, index, f.font_scale, f.font_scale, 3, 3, &ix0, &iy0, &ix1, &iy1);
+        gb.fd.advW = static_cast<uint8_t>(f.font_scale * advW);
+        gb.fd.ix0 = static_cast<int8_t>(f.font_scale * leftB);
+        gb.fd.iy0 = iy0;
+        gb.fd.w = ix1 - ix0;
+        gb.fd.h = iy1 - iy0;
+        gb.data.resize(gb.fd.w * gb.fd.h);
+        if (!gb.data.empty()) {
+            stbtt_MakeGlyphBitmapSubpixel(info, &gb.data[0], gb.fd.w, gb.fd.h, gb.fd.w, f.font_scale, f.font_scale, 3, 3, index);
+        }
+#else
+        auto index = FT_Get_Char_Index(f.face, ch);
+        if (index == 0) continue;
+        if (FT_Load_Glyph(f.face, index, FT_LOAD_DEFAULT)) continue;
+        if (FT_Render_Glyph(f.face->glyph, FT_RENDER_MODE_NORMAL)) continue;
+
+        FT_GlyphSlot slot = f.face->glyph;
+        gb.fd.ix0 = slot->bitmap_left;
+        gb.fd.iy0 = -slot->bitmap_top;
+        gb.fd.w = slot->bitmap.width;
+        gb.fd.h = slot->bitmap.rows;
+        gb.fd.advW = slot->advance.x >> 6;
+        gb.data.resize(gb.fd.w * gb.fd.h);
+        const unsigned char *src_ptr = slot->bitmap.buffer;
+        for (int k = 0; k < gb.fd.h; ++k) {
+            memcpy(&gb.data[k * gb.fd.w], src_ptr, gb.fd.w);
+            src_ptr += slot->bitmap.pitch;
+        }
+#endif
+        if (sdf) make_distance_field(gb);
+        return true;
+    }
+    return false;
+}
+
+void ttf_font_base::make_distance_field(glyph_bitmap &gb) {
+    if (gb.fd.w == 0 || gb.fd.h == 0) return;
+
+    struct sdf_offset {
+        int dx, dy;
+        float dist;
+    };
+    /* neighbour offsets inside spread radius, sorted by distance for early break */
+    static const std::vector<sdf_offset> offsets = [] {
+        std::vector<sdf_offset> result;
+        for (int dy = -sdf_spread - 1; dy <= sdf_spread + 1; ++dy) {
+            for (int dx = -sdf_spread - 1; dx <= sdf_spread + 1; ++dx) {
+                if (dx == 0 && dy == 0) continue;
+                float dist = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+                if (dist > static_cast<float>(sdf_spread) + 0.5f) continue;
+                result.push_back({dx, dy, dist});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const sdf_offset &a, const sdf_offset &b) { return a.dist < b.dist; });
+        return result;
+    }();
+
+    const int sw = gb.fd.w, sh = gb.fd.h;
+    const int dw = sw + sdf_spread * 2, dh = sh + sdf_spread * 2;
+    std::vector<uint8_t> cov(dw * dh, 0);
+    for (int j = 0; j < sh; ++j) {
+        memcpy(&cov[(j + sdf_spread) * dw + sdf_spread], &gb.data[j * sw], sw);
+    }
+
+    /* coverage tells how far the edge is from center of a pixel on the edge,
+     * distance to the edge through neighbour q is |p-q| - (coverage(q) - 0.5)
+     * for outside pixels, or |p-q| - (0.5 - coverage(q)) for inside pixels */
+    std::vector<uint8_t> out(dw * dh);
+    const float spread = static_cast<float>(sdf_spread);
+    for (int y = 0; y < dh; ++y) {
+        for (int x = 0; x < dw; ++x) {
+            int a = cov[y * dw + x];
+            float signed_dist;
+            if (a != 0 && a != 255) {
+                signed_dist = 0.5f - static_cast<float>(a) / 255.f;
+            } else {
+                bool inside = a == 255;
+                float best = spread;
+                for (const auto &o: offsets) {
+                    if (o.dist - 0.5f >= best) break;
+                    int qx = x + o.dx, qy = y + o.dy;
+                    if (qx < 0 || qy < 0 || qx >= dw || qy >= dh) continue;
+                    int qa = cov[qy * dw + qx];
+                    float d;
+                    if (inside) {
+                        if (qa == 255) continue;
+                        d = o.dist - (0.5f - static_cast<float>(qa) / 255.f);
+                    } else {
+                        if (qa == 0) continue;
+                        d = o.dist - (static_cast<float>(qa) / 255.f - 0.5f);
+                    }
+                    if (d < best) best = d;
+                }
+                signed_dist = inside ? -best : best;
+            }
+            /* 0.5 is on the edge, larger is inside */
+            float v = 0.5f - signed_dist / (spread * 2.f);
+            out[y * dw + x] = static_cast<uint8_t>(std::max(0.f, std::min(255.f, v * 255.f + 0.5f)));
+        }
+    }
+    gb.data = std::move(out);
+    gb.fd.ix0 -= sdf_spread;
+    gb.fd.iy0 -= sdf_spread;
+    gb.fd.w = dw;
+    gb.fd.h = dh;
+}
+
 void ttf_font_base::new_rect_pack() {
     auto *rpd = new rect_pack_data;
     stbrp_init_target(&rpd->context, TTF_RECTPACK_WIDTH, TTF_RECTPACK_WIDTH, rpd->nodes, TTF_RECTPACK_WIDTH);
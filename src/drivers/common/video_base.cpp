@@ -4,17 +4,31 @@ namespace drivers {
 
 void video_base::add_message(const char *text, uint32_t frames) {
     if (frames)
-        messages.emplace_back(text, frames);
+        messages.emplace_back(text, message_frames + frames);
 }
 
 void video_base::message_frame_pass() {
-    for (auto ite = messages.begin(); ite != messages.end();) {
-        if (--ite->second == 0) {
-            ite = messages.erase(ite);
-        } else {
-            ++ite;
-        }
+    ++message_frames;
+    while (!messages.empty() && !message_active(messages.front())) {
+        messages.pop_front();
     }
+    while (!messages.empty() && !message_active(messages.back())) {
+        messages.pop_back();
+    }
+}
+
+void video_base::clear_message_cache() {
+    for (auto &m: messages) {
+        m.cache.reset();
+    }
+}
+
+size_t video_base::active_messages() const {
+    size_t count = 0;
+    for (const auto &m: messages) {
+        if (message_active(m)) ++count;
+    }
+    return count;
 }
 
 }
@@ -0,0 +1,305 @@
+#include "sdl1_filter.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace drivers {
+
+/* candidates selected by lookup tables */
+enum :uint32_t {
+    SEL_E = 0,
+    SEL_B,
+    SEL_D,
+    SEL_F,
+    SEL_H,
+};
+
+/* equality bits used as lookup table index */
+enum :uint32_t {
+    EQ_BH = 1u << 0u,
+    EQ_DF = 1u << 1u,
+    EQ_BD = 1u << 2u,
+    EQ_BF = 1u << 3u,
+    EQ_DH = 1u << 4u,
+    EQ_FH = 1u << 5u,
+    /* Scale3x only */
+    EQ_EA = 1u << 6u,
+    EQ_EC = 1u << 7u,
+    EQ_EG = 1u << 8u,
+    EQ_EI = 1u << 9u,
+};
+
+/* each output pixel takes 3 bits of selector, row-major order */
+static const uint32_t *get_scale2x_lut() {
+    static const std::vector<uint32_t> lut = [] {
+        std::vector<uint32_t> result(64, 0);
+        for (uint32_t k = 0; k < 64; ++k) {
+            if (k & (EQ_BH | EQ_DF)) continue;
+            uint32_t sel[4] = {
+                (k & EQ_BD) ? SEL_D : SEL_E,
+                (k & EQ_BF) ? SEL_F : SEL_E,
+                (k & EQ_DH) ? SEL_D : SEL_E,
+                (k & EQ_FH) ? SEL_F : SEL_E,
+            };
+            for (uint32_t i = 0; i < 4; ++i) result[k] |= sel[i] << (i * 3u);
+        }
+        return result;
+    }();
+    return lut.data();
+}
+
+static const uint32_t *get_scale3x_lut() {
+    static const std::vector<uint32_t> lut = [] {
+        std::vector<uint32_t> result(1024, 0);
+        for (uint32_t k = 0; k < 1024; ++k) {
+            if (k & (EQ_BH | EQ_DF)) continue;
+            bool bd = k & EQ_BD, bf = k & EQ_BF, dh = k & EQ_DH, fh = k & EQ_FH;
+            bool ea = k & EQ_EA, ec = k & EQ_EC, eg = k & EQ_EG, ei = k & EQ_EI;
+            uint32_t sel[9] = {
+                bd ? SEL_D : SEL_E,
+                ((bd && !ec) || (bf && !ea)) ? SEL_B : SEL_E,
+                bf ? SEL_F : SEL_E,
+                ((bd && !eg) || (dh && !ea)) ? SEL_D : SEL_E,
+                SEL_E,
+                ((bf && !ei) || (fh && !ec)) ? SEL_F : SEL_E,
+                dh ? SEL_D : SEL_E,
+                ((dh && !ei) || (fh && !eg)) ? SEL_H : SEL_E,
+                fh ? SEL_F : SEL_E,
+            };
+            for (uint32_t i = 0; i < 9; ++i) result[k] |= sel[i] << (i * 3u);
+        }
+        return result;
+    }();
+    return lut.data();
+}
+
+/* packed Y << 16 | U << 8 | V for every RGB565 color */
+static const uint32_t *get_yuv_lut() {
+    static const std::vector<uint32_t> lut = [] {
+        std::vector<uint32_t> result(65536);
+        for (uint32_t p = 0; p < 65536; ++p) {
+            int r = static_cast<int>((p >> 11u) & 0x1Fu), g = static_cast<int>((p >> 5u) & 0x3Fu), b = static_cast<int>(p & 0x1Fu);
+            r = (r << 3) | (r >> 2);
+            g = (g << 2) | (g >> 4);
+            b = (b << 3) | (b >> 2);
+            int y = (299 * r + 587 * g + 114 * b) / 1000;
+            int u = (-169 * r - 331 * g + 500 * b) / 1000 + 128;
+            int v = (500 * r - 419 * g - 81 * b) / 1000 + 128;
+            y = std::max(0, std::min(255, y));
+            u = std::max(0, std::min(255, u));
+            v = std::max(0, std::min(255, v));
+            result[p] = static_cast<uint32_t>((y << 16) | (u << 8) | v);
+        }
+        return result;
+    }();
+    return lut.data();
+}
+
+static inline uint32_t to_rgb565(uint16_t p) { return p; }
+static inline uint32_t to_rgb565(uint32_t p) {
+    return ((p >> 8u) & 0xF800u) | ((p >> 5u) & 0x07E0u) | ((p >> 3u) & 0x001Fu);
+}
+
+/* average of two pixels */
+static inline uint16_t blend_half(uint16_t a, uint16_t b) {
+    return static_cast<uint16_t>((a & b) + (((a ^ b) & 0xF7DEu) >> 1u));
+}
+static inline uint32_t blend_half(uint32_t a, uint32_t b) {
+    return (a & b) + (((a ^ b) & 0xFEFEFEFEu) >> 1u);
+}
+
+static inline int yuv_diff(uint32_t a, uint32_t b) {
+    return 48 * std::abs(static_cast<int>(a >> 16u) - static_cast<int>(b >> 16u))
+        + 7 * std::abs(static_cast<int>((a >> 8u) & 0xFFu) - static_cast<int>((b >> 8u) & 0xFFu))
+        + 6 * std::abs(static_cast<int>(a & 0xFFu) - static_cast<int>(b & 0xFFu));
+}
+
+/* A B C
+ * D E F
+ * G H I */
+template<typename T, int S>
+static void scalex_band(uint8_t *dst, size_t dst_pitch, const uint8_t *src, size_t src_pitch,
+                        int width, int height, int y0, int y1) {
+    const uint32_t *lut = S == 2 ? get_scale2x_lut() : get_scale3x_lut();
+    for (int y = y0; y < y1; ++y) {
+        const auto *rb = reinterpret_cast<const T*>(src + (y > 0 ? y - 1 : 0) * src_pitch);
+        const auto *re = reinterpret_cast<const T*>(src + y * src_pitch);
+        const auto *rh = reinterpret_cast<const T*>(src + (y + 1 < height ? y + 1 : y) * src_pitch);
+        T *out[S];
+        for (int j = 0; j < S; ++j) {
+            out[j] = reinterpret_cast<T*>(dst + (y * S + j) * dst_pitch);
+        }
+        for (int x = 0; x < width; ++x) {
+            int xl = x > 0 ? x - 1 : 0;
+            int xr = x + 1 < width ? x + 1 : x;
+            const T c[5] = {re[x], rb[x], re[xl], re[xr], rh[x]};
+            uint32_t key = (c[SEL_B] == c[SEL_H] ? EQ_BH : 0u) | (c[SEL_D] == c[SEL_F] ? EQ_DF : 0u);
+            uint32_t sel = 0;
+            if (!key) {
+                key = (c[SEL_B] == c[SEL_D] ? EQ_BD : 0u) | (c[SEL_B] == c[SEL_F] ? EQ_BF : 0u)
+                    | (c[SEL_D] == c[SEL_H] ? EQ_DH : 0u) | (c[SEL_F] == c[SEL_H] ? EQ_FH : 0u);
+                if (S == 3) {
+                    key |= (c[SEL_E] == rb[xl] ? EQ_EA : 0u) | (c[SEL_E] == rb[xr] ? EQ_EC : 0u)
+                        | (c[SEL_E] == rh[xl] ? EQ_EG : 0u) | (c[SEL_E] == rh[xr] ? EQ_EI : 0u);
+                }
+                sel = lut[key];
+            }
+            for (int j = 0; j < S; ++j) {
+                T *o = out[j] + x * S;
+                for (int i = 0; i < S; ++i) {
+                    o[i] = c[sel & 7u];
+                    sel >>= 3u;
+                }
+            }
+        }
+    }
+}
+
+/* simplified 2xBR level 1, only 3x3 neighbours are used for edge detection */
+template<typename T>
+static void xbr_lite_band(uint8_t *dst, size_t dst_pitch, const uint8_t *src, size_t src_pitch,
+                          int width, int height, int y0, int y1) {
+    const uint32_t *yuv = get_yuv_lut();
+    for (int y = y0; y < y1; ++y) {
+        const auto *rb = reinterpret_cast<const T*>(src + (y > 0 ? y - 1 : 0) * src_pitch);
+        const auto *re = reinterpret_cast<const T*>(src + y * src_pitch);
+        const auto *rh = reinterpret_cast<const T*>(src + (y + 1 < height ? y + 1 : y) * src_pitch);
+        auto *out0 = reinterpret_cast<T*>(dst + y * 2 * dst_pitch);
+        auto *out1 = reinterpret_cast<T*>(dst + (y * 2 + 1) * dst_pitch);
+        for (int x = 0; x < width; ++x) {
+            int xl = x > 0 ? x - 1 : 0;
+            int xr = x + 1 < width ? x + 1 : x;
+            T B = rb[x], D = re[xl], E = re[x], F = re[xr], H = rh[x];
+            T e0 = E, e1 = E, e2 = E, e3 = E;
+            if (!(E == B && E == D && E == F && E == H)) {
+                uint32_t ya = yuv[to_rgb565(rb[xl])], yb = yuv[to_rgb565(B)], yc = yuv[to_rgb565(rb[xr])];
+                uint32_t yd = yuv[to_rgb565(D)], ye = yuv[to_rgb565(E)], yf = yuv[to_rgb565(F)];
+                uint32_t yg = yuv[to_rgb565(rh[xl])], yh = yuv[to_rgb565(H)], yi = yuv[to_rgb565(rh[xr])];
+                int d_ea = yuv_diff(ye, ya), d_ec = yuv_diff(ye, yc), d_eg = yuv_diff(ye, yg), d_ei = yuv_diff(ye, yi);
+                int d_bd = yuv_diff(yb, yd), d_bf = yuv_diff(yb, yf), d_dh = yuv_diff(yd, yh), d_fh = yuv_diff(yf, yh);
+                int d_eb = yuv_diff(ye, yb), d_ed = yuv_diff(ye, yd), d_ef = yuv_diff(ye, yf), d_eh = yuv_diff(ye, yh);
+                if (E != D && E != B && d_eg + d_ec + 4 * d_bd < d_bf + d_dh + 4 * d_ea) {
+                    e0 = blend_half(E, d_ed <= d_eb ? D : B);
+                }
+                if (E != F && E != B && d_ei + d_ea + 4 * d_bf < d_bd + d_fh + 4 * d_ec) {
+                    e1 = blend_half(E, d_ef <= d_eb ? F : B);
+                }
+                if (E != D && E != H && d_ea + d_ei + 4 * d_dh < d_fh + d_bd + 4 * d_eg) {
+                    e2 = blend_half(E, d_ed <= d_eh ? D : H);
+                }
+                if (E != F && E != H && d_ec + d_eg + 4 * d_fh < d_dh + d_bf + 4 * d_ei) {
+                    e3 = blend_half(E, d_ef <= d_eh ? F : H);
+                }
+            }
+            out0[x * 2] = e0;
+            out0[x * 2 + 1] = e1;
+            out1[x * 2] = e2;
+            out1[x * 2 + 1] = e3;
+        }
+    }
+}
+
+sdl1_filter::~sdl1_filter() {
+    stop_workers();
+}
+
+bool sdl1_filter::init(uint32_t filter, int scale, unsigned bpp) {
+    if (filter == curr_filter && scale == curr_scale && bpp == curr_bpp) return func != nullptr;
+    curr_filter = filter;
+    curr_scale = scale;
+    curr_bpp = bpp;
+    func = nullptr;
+    switch (filter) {
+    case filter_scalex:
+        if (scale == 2) func = bpp == 32 ? scalex_band<uint32_t, 2> : scalex_band<uint16_t, 2>;
+        else if (scale == 3) func = bpp == 32 ? scalex_band<uint32_t, 3> : scalex_band<uint16_t, 3>;
+        break;
+    case filter_xbr_lite:
+        if (scale == 2) func = bpp == 32 ? xbr_lite_band<uint32_t> : xbr_lite_band<uint16_t>;
+        break;
+    default:
+        break;
+    }
+    if (bpp != 16 && bpp != 32) func = nullptr;
+    if (!func) {
+        stop_workers();
+        LOG(TRACE, "Filter {} does not support {}x on {}bpp surface", filter, scale, bpp);
+        return false;
+    }
+    start_workers();
+    LOG(TRACE, "Using filter {} for {}x on {}bpp surface with {} threads", filter, scale, bpp, workers.size() + 1);
+    return true;
+}
+
+void sdl1_filter::process(void *dst, size_t dst_pitch, const void *src, size_t src_pitch, int width, int height) {
+    job.dst = static_cast<uint8_t*>(dst);
+    job.dst_pitch = dst_pitch;
+    job.src = static_cast<const uint8_t*>(src);
+    job.src_pitch = src_pitch;
+    job.width = width;
+    job.height = height;
+    if (!workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            ++generation;
+            pending = workers.size();
+        }
+        cond_start.notify_all();
+    }
+    run_band(0);
+    if (!workers.empty()) {
+        std::unique_lock<std::mutex> lk(mutex);
+        cond_done.wait(lk, [this] { return pending == 0; });
+    }
+}
+
+void sdl1_filter::start_workers() {
+    if (!workers.empty()) return;
+    size_t count = std::min(4u, std::thread::hardware_concurrency());
+    quit = false;
+    for (size_t i = 1; i < count; ++i) {
+        workers.emplace_back(&sdl1_filter::worker_proc, this, i, generation);
+    }
+}
+
+void sdl1_filter::stop_workers() {
+    if (workers.empty()) return;
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        quit = true;
+    }
+    cond_start.notify_all();
+    for (auto &t: workers) {
+        t.join();
+    }
+    workers.clear();
+}
+
+void sdl1_filter::worker_proc(size_t index, uint32_t seen) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cond_start.wait(lk, [this, seen] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        run_band(index);
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (--pending == 0) cond_done.notify_one();
+        }
+    }
+}
+
+void sdl1_filter::run_band(size_t index) {
+    auto bands = static_cast<int>(workers.size() + 1);
+    int y0 = job.height * static_cast<int>(index) / bands;
+    int y1 = job.height * static_cast<int>(index + 1) / bands;
+    if (y0 < y1) {
+        func(job.dst, job.dst_pitch, job.src, job.src_pitch, job.width, job.height, y0, y1);
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace drivers {
+
+/* edge-aware pixel-art filters for software surfaces,
+ * frame is split into row bands which are processed by worker threads */
+class sdl1_filter {
+public:
+    enum :uint32_t {
+        filter_none = 0,
+        /* Scale2x for scale 2, Scale3x for scale 3 */
+        filter_scalex,
+        /* 2xBR level 1 without outer pixels */
+        filter_xbr_lite,
+    };
+
+    /* band kernel: filter source rows [y0, y1) */
+    using band_func = void (*)(uint8_t *dst, size_t dst_pitch, const uint8_t *src, size_t src_pitch,
+                               int width, int height, int y0, int y1);
+
+    sdl1_filter() = default;
+    ~sdl1_filter();
+
+    /* select filter for scale and bpp (16 or 32),
+     * returns false if the filter does not support them, caller should fallback to plain scaler */
+    bool init(uint32_t filter, int scale, unsigned bpp);
+    void process(void *dst, size_t dst_pitch, const void *src, size_t src_pitch, int width, int height);
+
+private:
+    void start_workers();
+    void stop_workers();
+    void worker_proc(size_t index, uint32_t seen);
+    void run_band(size_t index);
+
+private:
+    band_func func = nullptr;
+    uint32_t curr_filter = filter_none;
+    int curr_scale = 0;
+    unsigned curr_bpp = 0;
+
+    /* current job */
+    struct {
+        uint8_t *dst;
+        size_t dst_pitch;
+        const uint8_t *src;
+        size_t src_pitch;
+        int width, height;
+    } job = {};
+
+    /* band 0 is processed by caller thread */
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cond_start, cond_done;
+    uint32_t generation = 0;
+    size_t pending = 0;
+    bool quit = false;
+};
+
+}
@@ -34,41 +34,60 @@ sdl1_impl::~sdl1_impl() {
 bool sdl1_impl::process_events() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-        case SDL_QUIT:
-            return true;
-        case SDL_KEYDOWN:
-        case SDL_KEYUP:
-            if (event.key.keysym.sym ==
+        if (handle_event(event)) return true;
+    }
+    return false;
+}
+
+bool sdl1_impl::wait_events(uint32_t timeout) {
+    /* SDL1 has no SDL_WaitEventTimeout, sleep in short steps like SDL_WaitEvent does internally */
+    SDL_Event event;
+    uint32_t start = SDL_GetTicks();
+    while (!SDL_PollEvent(&event)) {
+        if (SDL_GetTicks() - start >= timeout) {
+            return false;
+        }
+        SDL_Delay(10);
+    }
+    if (handle_event(event)) return true;
+    return process_events();
+}
+
+bool sdl1_impl::handle_event(const SDL_Event &event) {
+    switch (event.type) {
+    case SDL_QUIT:
+        return true;
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        if (event.key.keysym.sym ==
 #ifdef GCW_ZERO
-                SDLK_HOME
+            SDLK_HOME
 #else
-                SDLK_ESCAPE
+            SDLK_ESCAPE
 #endif
-                ) {
-                if (event.type == SDL_KEYDOWN) {
-                    if (!menu_button_pressed)
-                        menu_button_pressed = true;
-                    else
-                        return true;
-                }
-            } else {
-                input->on_km_input(event.key.keysym.sym, event.type == SDL_KEYDOWN);
+            ) {
+            if (event.type == SDL_KEYDOWN) {
+                if (!menu_button_pressed)
+                    menu_button_pressed = true;
+                else
+                    return true;
             }
-            break;
-        case SDL_MOUSEBUTTONDOWN:
-        case SDL_MOUSEBUTTONUP:
-            input->on_km_input(event.button.button + 1024, event.type == SDL_MOUSEBUTTONDOWN);
-            break;
-        case SDL_JOYBUTTONDOWN:
-        case SDL_JOYBUTTONUP:
-            input->on_btn_input(event.jbutton.which, event.jbutton.button, event.type == SDL_JOYBUTTONDOWN);
-            break;
-        case SDL_JOYAXISMOTION:
-            input->on_axis_input(event.jaxis.which, event.jaxis.axis, event.jaxis.value);
-            break;
-        default: break;
+        } else {
+            input->on_km_input(event.key.keysym.sym, event.type == SDL_KEYDOWN);
         }
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+        input->on_km_input(event.button.button + 1024, event.type == SDL_MOUSEBUTTONDOWN);
+        break;
+    case SDL_JOYBUTTONDOWN:
+    case SDL_JOYBUTTONUP:
+        input->on_btn_input(event.jbutton.which, event.jbutton.button, event.type == SDL_JOYBUTTONDOWN);
+        break;
+    case SDL_JOYAXISMOTION:
+        input->on_axis_input(event.jaxis.which, event.jaxis.axis, event.jaxis.value);
+        break;
+    default: break;
     }
     return false;
 }
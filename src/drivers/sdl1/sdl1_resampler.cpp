@@ -0,0 +1,302 @@
+#include "sdl1_resampler.h"
+
+#include "logger.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLER_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESAMPLER_USE_NEON
+#elif defined(__mips_msa)
+#include <msa.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_MIPS_MSA
+#define HWCAP_MIPS_MSA (1u << 1u)
+#endif
+#define RESAMPLER_USE_MSA
+#endif
+
+namespace drivers {
+
+enum :uint32_t {
+    /* 0000 0000 000R RRRR 0000 0000 000B BBBB after moving red of RGB565 to upper half,
+     * leaves 11 spare bits above red and blue for multiplying by 8-bit weights */
+    RGB565_RB_MASK = 0x001F001Fu,
+    ROW_INDEX_NONE = ~0u,
+};
+
+static inline uint32_t expand_rb_565(uint16_t p) {
+    return (p & 0x1Fu) | (static_cast<uint32_t>(p & 0xF800u) << 5u);
+}
+
+/* same 8-bit weights and rounding as SIMD paths, so that tail pixels match */
+static inline uint16_t lerp_565(uint16_t a, uint16_t b, uint32_t w) {
+    uint32_t iw = 256u - w;
+    uint32_t rb = ((expand_rb_565(a) * iw + expand_rb_565(b) * w) >> 8u) & RGB565_RB_MASK;
+    uint32_t g = (((a >> 5u) & 0x3Fu) * iw + ((b >> 5u) & 0x3Fu) * w) >> 8u;
+    return static_cast<uint16_t>(((rb >> 5u) & 0xF800u) | (g << 5u) | (rb & 0x1Fu));
+}
+
+static inline uint32_t lerp_8888(uint32_t a, uint32_t b, uint32_t w) {
+    uint32_t iw = 256u - w;
+    uint32_t rb = (((a & 0xFF00FFu) * iw + (b & 0xFF00FFu) * w) >> 8u) & 0xFF00FFu;
+    uint32_t g = (((a & 0x00FF00u) * iw + (b & 0x00FF00u) * w) >> 8u) & 0x00FF00u;
+    return rb | g;
+}
+
+static void blend_c_16(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *sa = static_cast<const uint16_t*>(a);
+    const auto *sb = static_cast<const uint16_t*>(b);
+    for (int i = 0; i < count; ++i) {
+        d[i] = lerp_565(sa[i], sb[i], w);
+    }
+}
+
+static void blend_c_32(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *sa = static_cast<const uint32_t*>(a);
+    const auto *sb = static_cast<const uint32_t*>(b);
+    for (int i = 0; i < count; ++i) {
+        d[i] = lerp_8888(sa[i], sb[i], w);
+    }
+}
+
+#if defined(RESAMPLER_USE_SSE2)
+/* channels are blended in 16-bit lanes with full 8-bit weights:
+ * a * (256 - w) + b * w <= 255 * 256 never overflows */
+static inline __m128i lerp_epi16(__m128i a, __m128i b, __m128i wa, __m128i wb) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, wa), _mm_mullo_epi16(b, wb)), 8);
+}
+
+static void blend_sse2_16(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *sa = static_cast<const uint16_t*>(a);
+    const auto *sb = static_cast<const uint16_t*>(b);
+    const __m128i wa = _mm_set1_epi16(static_cast<short>(256 - w));
+    const __m128i wb = _mm_set1_epi16(static_cast<short>(w));
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sa + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sb + i));
+        __m128i r = lerp_epi16(_mm_srli_epi16(va, 11), _mm_srli_epi16(vb, 11), wa, wb);
+        __m128i g = lerp_epi16(_mm_and_si128(_mm_srli_epi16(va, 5), mask6),
+                               _mm_and_si128(_mm_srli_epi16(vb, 5), mask6), wa, wb);
+        __m128i bl = lerp_epi16(_mm_and_si128(va, mask5), _mm_and_si128(vb, mask5), wa, wb);
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), bl);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), v);
+    }
+    blend_c_16(d + i, sa + i, sb + i, count - i, w);
+}
+
+static void blend_sse2_32(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *sa = static_cast<const uint32_t*>(a);
+    const auto *sb = static_cast<const uint32_t*>(b);
+    const __m128i wa = _mm_set1_epi16(static_cast<short>(256 - w));
+    const __m128i wb = _mm_set1_epi16(static_cast<short>(w));
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sa + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sb + i));
+        __m128i lo = lerp_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero), wa, wb);
+        __m128i hi = lerp_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero), wa, wb);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_c_32(d + i, sa + i, sb + i, count - i, w);
+}
+#elif defined(RESAMPLER_USE_NEON)
+static inline uint16x8_t lerp_u16(uint16x8_t a, uint16x8_t b, uint16x8_t wa, uint16x8_t wb) {
+    return vshrq_n_u16(vmlaq_u16(vmulq_u16(a, wa), b, wb), 8);
+}
+
+static void blend_neon_16(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *sa = static_cast<const uint16_t*>(a);
+    const auto *sb = static_cast<const uint16_t*>(b);
+    const uint16x8_t wa = vdupq_n_u16(static_cast<uint16_t>(256 - w));
+    const uint16x8_t wb = vdupq_n_u16(static_cast<uint16_t>(w));
+    const uint16x8_t mask5 = vdupq_n_u16(0x1F);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3F);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t va = vld1q_u16(sa + i);
+        uint16x8_t vb = vld1q_u16(sb + i);
+        uint16x8_t r = lerp_u16(vshrq_n_u16(va, 11), vshrq_n_u16(vb, 11), wa, wb);
+        uint16x8_t g = lerp_u16(vandq_u16(vshrq_n_u16(va, 5), mask6), vandq_u16(vshrq_n_u16(vb, 5), mask6), wa, wb);
+        uint16x8_t bl = lerp_u16(vandq_u16(va, mask5), vandq_u16(vb, mask5), wa, wb);
+        vst1q_u16(d + i, vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), bl));
+    }
+    blend_c_16(d + i, sa + i, sb + i, count - i, w);
+}
+
+static void blend_neon_32(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *sa = static_cast<const uint32_t*>(a);
+    const auto *sb = static_cast<const uint32_t*>(b);
+    const uint16x8_t wa = vdupq_n_u16(static_cast<uint16_t>(256 - w));
+    const uint16x8_t wb = vdupq_n_u16(static_cast<uint16_t>(w));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t va = vld1q_u8(reinterpret_cast<const uint8_t*>(sa + i));
+        uint8x16_t vb = vld1q_u8(reinterpret_cast<const uint8_t*>(sb + i));
+        uint16x8_t lo = lerp_u16(vmovl_u8(vget_low_u8(va)), vmovl_u8(vget_low_u8(vb)), wa, wb);
+        uint16x8_t hi = lerp_u16(vmovl_u8(vget_high_u8(va)), vmovl_u8(vget_high_u8(vb)), wa, wb);
+        vst1q_u8(reinterpret_cast<uint8_t*>(d + i), vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+    blend_c_32(d + i, sa + i, sb + i, count - i, w);
+}
+#elif defined(RESAMPLER_USE_MSA)
+static inline v8i16 lerp_msa_h(v8i16 a, v8i16 b, v8i16 wa, v8i16 wb) {
+    return __msa_srli_h(__msa_maddv_h(__msa_mulv_h(a, wa), b, wb), 8);
+}
+
+static void blend_msa_16(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *sa = static_cast<const uint16_t*>(a);
+    const auto *sb = static_cast<const uint16_t*>(b);
+    const v8i16 wa = __msa_fill_h(static_cast<int>(256 - w));
+    const v8i16 wb = __msa_fill_h(static_cast<int>(w));
+    const v16u8 mask5 = (v16u8)__msa_fill_h(0x1F);
+    const v16u8 mask6 = (v16u8)__msa_fill_h(0x3F);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        v8i16 va = __msa_ld_h((void*)(sa + i), 0);
+        v8i16 vb = __msa_ld_h((void*)(sb + i), 0);
+        v8i16 r = lerp_msa_h(__msa_srli_h(va, 11), __msa_srli_h(vb, 11), wa, wb);
+        v8i16 g = lerp_msa_h((v8i16)__msa_and_v((v16u8)__msa_srli_h(va, 5), mask6),
+                             (v8i16)__msa_and_v((v16u8)__msa_srli_h(vb, 5), mask6), wa, wb);
+        v8i16 bl = lerp_msa_h((v8i16)__msa_and_v((v16u8)va, mask5), (v8i16)__msa_and_v((v16u8)vb, mask5), wa, wb);
+        v16u8 v = __msa_or_v(__msa_or_v((v16u8)__msa_slli_h(r, 11), (v16u8)__msa_slli_h(g, 5)), (v16u8)bl);
+        __msa_st_h((v8i16)v, d + i, 0);
+    }
+    blend_c_16(d + i, sa + i, sb + i, count - i, w);
+}
+
+static void blend_msa_32(void *dst, const void *a, const void *b, int count, uint32_t w) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *sa = static_cast<const uint32_t*>(a);
+    const auto *sb = static_cast<const uint32_t*>(b);
+    const v8i16 wa = __msa_fill_h(static_cast<int>(256 - w));
+    const v8i16 wb = __msa_fill_h(static_cast<int>(w));
+    const v16i8 zero = __msa_fill_b(0);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        v16i8 va = __msa_ld_b((void*)(sa + i), 0);
+        v16i8 vb = __msa_ld_b((void*)(sb + i), 0);
+        v8i16 lo = lerp_msa_h((v8i16)__msa_ilvr_b(zero, va), (v8i16)__msa_ilvr_b(zero, vb), wa, wb);
+        v8i16 hi = lerp_msa_h((v8i16)__msa_ilvl_b(zero, va), (v8i16)__msa_ilvl_b(zero, vb), wa, wb);
+        __msa_st_b(__msa_pckev_b((v16i8)hi, (v16i8)lo), d + i, 0);
+    }
+    blend_c_32(d + i, sa + i, sb + i, count - i, w);
+}
+#endif
+
+/* horizontal pass is a gather through the weight table, kept scalar */
+static void scale_row_16(uint16_t *dst, const uint16_t *src, const sdl1_resampler::coord *c, int count) {
+    for (int i = 0; i < count; ++i, ++c) {
+        dst[i] = c->w ? lerp_565(src[c->i0], src[c->i1], c->w) : src[c->i0];
+    }
+}
+
+static void scale_row_32(uint32_t *dst, const uint32_t *src, const sdl1_resampler::coord *c, int count) {
+    for (int i = 0; i < count; ++i, ++c) {
+        dst[i] = c->w ? lerp_8888(src[c->i0], src[c->i1], c->w) : src[c->i0];
+    }
+}
+
+void sdl1_resampler::build_table(std::vector<coord> &table, int src_size, int dst_size) {
+    table.resize(dst_size);
+    /* 16.16 fixed point, sample at pixel centers */
+    int64_t step = (static_cast<int64_t>(src_size) << 16) / dst_size;
+    int64_t pos = step / 2 - 0x8000;
+    auto last = static_cast<uint32_t>(src_size - 1);
+    for (auto &c: table) {
+        int64_t p = pos < 0 ? 0 : pos;
+        pos += step;
+        c.i0 = static_cast<uint32_t>(p >> 16);
+        if (c.i0 >= last) {
+            c.i0 = c.i1 = last;
+            c.w = 0;
+        } else {
+            c.i1 = c.i0 + 1;
+            c.w = static_cast<uint32_t>(p >> 8) & 0xFFu;
+        }
+    }
+}
+
+bool sdl1_resampler::init(int src_width, int src_height, int dst_width, int dst_height, unsigned bits) {
+    if (blend && src_width == src_w && src_height == src_h && dst_width == dst_w && dst_height == dst_h && bits == bpp) {
+        return true;
+    }
+    blend = nullptr;
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0 || (bits != 16 && bits != 32)) {
+        return false;
+    }
+    src_w = src_width;
+    src_h = src_height;
+    dst_w = dst_width;
+    dst_h = dst_height;
+    bpp = bits;
+    build_table(xtab, src_w, dst_w);
+    build_table(ytab, src_h, dst_h);
+    for (auto &r: rows) {
+        r.resize(static_cast<size_t>(dst_w) * (bpp >> 3u));
+    }
+#if defined(RESAMPLER_USE_SSE2)
+    blend = bpp == 32 ? blend_sse2_32 : blend_sse2_16;
+#elif defined(RESAMPLER_USE_NEON)
+    blend = bpp == 32 ? blend_neon_32 : blend_neon_16;
+#elif defined(RESAMPLER_USE_MSA)
+    if ((getauxval(AT_HWCAP) & HWCAP_MIPS_MSA) != 0) {
+        blend = bpp == 32 ? blend_msa_32 : blend_msa_16;
+    } else {
+        blend = bpp == 32 ? blend_c_32 : blend_c_16;
+    }
+#else
+    blend = bpp == 32 ? blend_c_32 : blend_c_16;
+#endif
+    LOG(TRACE, "Resampler {}x{} -> {}x{} on {}bpp surface", src_w, src_h, dst_w, dst_h, bpp);
+    return true;
+}
+
+const uint8_t *sdl1_resampler::fetch_row(const uint8_t *src, size_t src_pitch, uint32_t y, uint32_t keep) {
+    if (row_index[0] == y) return rows[0].data();
+    if (row_index[1] == y) return rows[1].data();
+    size_t slot = row_index[0] == keep ? 1 : 0;
+    row_index[slot] = y;
+    auto *d = rows[slot].data();
+    const auto *s = src + y * src_pitch;
+    if (bpp == 32) {
+        scale_row_32(reinterpret_cast<uint32_t*>(d), reinterpret_cast<const uint32_t*>(s), xtab.data(), dst_w);
+    } else {
+        scale_row_16(reinterpret_cast<uint16_t*>(d), reinterpret_cast<const uint16_t*>(s), xtab.data(), dst_w);
+    }
+    return d;
+}
+
+void sdl1_resampler::process(void *dst, size_t dst_pitch, const void *src, size_t src_pitch) {
+    if (!blend) return;
+    row_index[0] = row_index[1] = ROW_INDEX_NONE;
+    auto line_bytes = static_cast<size_t>(dst_w) * (bpp >> 3u);
+    auto *d = static_cast<uint8_t*>(dst);
+    const auto *s = static_cast<const uint8_t*>(src);
+    for (const auto &c: ytab) {
+        if (c.w == 0) {
+            memcpy(d, fetch_row(s, src_pitch, c.i0, c.i0), line_bytes);
+        } else {
+            const auto *r0 = fetch_row(s, src_pitch, c.i0, c.i1);
+            const auto *r1 = fetch_row(s, src_pitch, c.i1, c.i0);
+            blend(d, r0, r1, dst_w, c.w);
+        }
+        d += dst_pitch;
+    }
+}
+
+}
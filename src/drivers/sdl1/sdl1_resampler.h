@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace drivers {
+
+/* fixed-point bilinear scaler for arbitrary ratios on software surfaces,
+ * source rows are scaled horizontally once into a 2-row cache,
+ * then each output row is a vertical blend of two cached rows */
+class sdl1_resampler {
+public:
+    /* vertical blend kernel: dst = a * (256 - w) + b * w, for `count` pixels */
+    using blend_func = void (*)(void *dst, const void *a, const void *b, int count, uint32_t w);
+
+    /* rebuild weight tables if sizes or bpp (16 or 32) changed,
+     * returns false if arguments are not supported */
+    bool init(int src_width, int src_height, int dst_width, int dst_height, unsigned bpp);
+    void process(void *dst, size_t dst_pitch, const void *src, size_t src_pitch);
+
+    /* sample position: pixels i0 and i1 blended with weight of i1 in 0-255 */
+    struct coord {
+        uint32_t i0, i1, w;
+    };
+
+private:
+    const uint8_t *fetch_row(const uint8_t *src, size_t src_pitch, uint32_t y, uint32_t keep);
+
+    static void build_table(std::vector<coord> &table, int src_size, int dst_size);
+
+private:
+    blend_func blend = nullptr;
+    std::vector<coord> xtab, ytab;
+    std::vector<uint8_t> rows[2];
+    uint32_t row_index[2] = {};
+    int src_w = 0, src_h = 0, dst_w = 0, dst_h = 0;
+    unsigned bpp = 0;
+};
+
+}
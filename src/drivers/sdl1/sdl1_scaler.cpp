@@ -0,0 +1,450 @@
+#include "sdl1_scaler.h"
+
+#include "perf.h"
+#include "libretro.h"
+#include "logger.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCALER_USE_SSE2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCALER_USE_NEON
+#endif
+#if defined(__mips_msa)
+#include <msa.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_MIPS_MSA
+#define HWCAP_MIPS_MSA (1u << 1u)
+#endif
+#define SCALER_USE_MSA
+#endif
+
+namespace drivers {
+
+template<typename T>
+static void row_c(void *dst, const void *src, int width, int scale) {
+    auto *d = static_cast<T*>(dst);
+    const auto *s = static_cast<const T*>(src);
+    for (int i = width; i; --i) {
+        T pix = *s++;
+        for (int j = scale; j; --j) {
+            *d++ = pix;
+        }
+    }
+}
+
+/* fixed scale lets compiler unroll the inner loop */
+template<typename T, int S>
+static void row_c_fixed(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<T*>(dst);
+    const auto *s = static_cast<const T*>(src);
+    for (int i = width; i; --i) {
+        T pix = *s++;
+        for (int j = 0; j < S; ++j) {
+            d[j] = pix;
+        }
+        d += S;
+    }
+}
+
+#ifdef SCALER_USE_SSE2
+/* pick 32-bit lanes by mask: (a & mask) | (b & ~mask) */
+static inline __m128i select_si128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void row_sse2_16_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_unpackhi_epi16(v, v));
+        d += 16;
+    }
+    row_c_fixed<uint16_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_sse2_16_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const __m128i m1 = _mm_set_epi32(0, 0, -1, 0);
+    const __m128i m2 = _mm_set_epi32(0, -1, 0, 0);
+    const __m128i m03 = _mm_set_epi32(-1, 0, 0, -1);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        /* v: a b c d e f g h, lo: a a b b c c d d, hi: e e f f g g h h */
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i lo = _mm_unpacklo_epi16(v, v);
+        __m128i hi = _mm_unpackhi_epi16(v, v);
+        /* a a a b b b c c */
+        __m128i o0 = select_si128(m1, _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0)),
+                                  _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 1, 0, 0)));
+        /* c d d d e e e f */
+        __m128i o1 = _mm_or_si128(_mm_and_si128(m03, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1))),
+                                  _mm_or_si128(_mm_and_si128(m1, _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 3, 3))),
+                                               _mm_and_si128(m2, _mm_shuffle_epi32(hi, _MM_SHUFFLE(0, 0, 0, 0)))));
+        /* f f g g g h h h */
+        __m128i o2 = select_si128(m2, _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)),
+                                  _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 2, 2, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), o0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), o1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), o2);
+        d += 24;
+    }
+    row_c_fixed<uint16_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_sse2_16_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i lo = _mm_unpacklo_epi16(v, v);
+        __m128i hi = _mm_unpackhi_epi16(v, v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi32(lo, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_unpackhi_epi32(lo, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), _mm_unpacklo_epi32(hi, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 24), _mm_unpackhi_epi32(hi, hi));
+        d += 32;
+    }
+    row_c_fixed<uint16_t, 4>(d, s + i, width - i, 4);
+}
+
+static void row_sse2_32_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4), _mm_unpackhi_epi32(v, v));
+        d += 8;
+    }
+    row_c_fixed<uint32_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_sse2_32_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+        d += 12;
+    }
+    row_c_fixed<uint32_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_sse2_32_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_shuffle_epi32(v, 0x00));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 4), _mm_shuffle_epi32(v, 0x55));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_shuffle_epi32(v, 0xAA));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 12), _mm_shuffle_epi32(v, 0xFF));
+        d += 16;
+    }
+    row_c_fixed<uint32_t, 4>(d, s + i, width - i, 4);
+}
+#endif
+
+#ifdef SCALER_USE_NEON
+/* interleaved stores of the same vector write each pixel `scale` times */
+static void row_neon_16_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        uint16x8_t v = vld1q_u16(s + i);
+        uint16x8x2_t o = {{v, v}};
+        vst2q_u16(d, o);
+        d += 16;
+    }
+    row_c_fixed<uint16_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_neon_16_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        uint16x8_t v = vld1q_u16(s + i);
+        uint16x8x3_t o = {{v, v, v}};
+        vst3q_u16(d, o);
+        d += 24;
+    }
+    row_c_fixed<uint16_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_neon_16_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        uint16x8_t v = vld1q_u16(s + i);
+        uint16x8x4_t o = {{v, v, v, v}};
+        vst4q_u16(d, o);
+        d += 32;
+    }
+    row_c_fixed<uint16_t, 4>(d, s + i, width - i, 4);
+}
+
+static void row_neon_32_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        uint32x4_t v = vld1q_u32(s + i);
+        uint32x4x2_t o = {{v, v}};
+        vst2q_u32(d, o);
+        d += 8;
+    }
+    row_c_fixed<uint32_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_neon_32_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        uint32x4_t v = vld1q_u32(s + i);
+        uint32x4x3_t o = {{v, v, v}};
+        vst3q_u32(d, o);
+        d += 12;
+    }
+    row_c_fixed<uint32_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_neon_32_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        uint32x4_t v = vld1q_u32(s + i);
+        uint32x4x4_t o = {{v, v, v, v}};
+        vst4q_u32(d, o);
+        d += 16;
+    }
+    row_c_fixed<uint32_t, 4>(d, s + i, width - i, 4);
+}
+#endif
+
+#ifdef SCALER_USE_MSA
+static void row_msa_16_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        v8i16 v = __msa_ld_h((void*)(s + i), 0);
+        __msa_st_h(__msa_ilvr_h(v, v), d, 0);
+        __msa_st_h(__msa_ilvl_h(v, v), d + 8, 0);
+        d += 16;
+    }
+    row_c_fixed<uint16_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_msa_16_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    const v8i16 idx0 = {0, 0, 0, 1, 1, 1, 2, 2};
+    const v8i16 idx1 = {2, 3, 3, 3, 4, 4, 4, 5};
+    const v8i16 idx2 = {5, 5, 6, 6, 6, 7, 7, 7};
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        v8i16 v = __msa_ld_h((void*)(s + i), 0);
+        __msa_st_h(__msa_vshf_h(idx0, v, v), d, 0);
+        __msa_st_h(__msa_vshf_h(idx1, v, v), d + 8, 0);
+        __msa_st_h(__msa_vshf_h(idx2, v, v), d + 16, 0);
+        d += 24;
+    }
+    row_c_fixed<uint16_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_msa_16_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint16_t*>(dst);
+    const auto *s = static_cast<const uint16_t*>(src);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        v8i16 v = __msa_ld_h((void*)(s + i), 0);
+        v4i32 lo = (v4i32)__msa_ilvr_h(v, v);
+        v4i32 hi = (v4i32)__msa_ilvl_h(v, v);
+        __msa_st_w(__msa_ilvr_w(lo, lo), d, 0);
+        __msa_st_w(__msa_ilvl_w(lo, lo), d + 8, 0);
+        __msa_st_w(__msa_ilvr_w(hi, hi), d + 16, 0);
+        __msa_st_w(__msa_ilvl_w(hi, hi), d + 24, 0);
+        d += 32;
+    }
+    row_c_fixed<uint16_t, 4>(d, s + i, width - i, 4);
+}
+
+static void row_msa_32_2x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        v4i32 v = __msa_ld_w((void*)(s + i), 0);
+        __msa_st_w(__msa_ilvr_w(v, v), d, 0);
+        __msa_st_w(__msa_ilvl_w(v, v), d + 4, 0);
+        d += 8;
+    }
+    row_c_fixed<uint32_t, 2>(d, s + i, width - i, 2);
+}
+
+static void row_msa_32_3x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    const v4i32 idx0 = {0, 0, 0, 1};
+    const v4i32 idx1 = {1, 1, 2, 2};
+    const v4i32 idx2 = {2, 3, 3, 3};
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        v4i32 v = __msa_ld_w((void*)(s + i), 0);
+        __msa_st_w(__msa_vshf_w(idx0, v, v), d, 0);
+        __msa_st_w(__msa_vshf_w(idx1, v, v), d + 4, 0);
+        __msa_st_w(__msa_vshf_w(idx2, v, v), d + 8, 0);
+        d += 12;
+    }
+    row_c_fixed<uint32_t, 3>(d, s + i, width - i, 3);
+}
+
+static void row_msa_32_4x(void *dst, const void *src, int width, int) {
+    auto *d = static_cast<uint32_t*>(dst);
+    const auto *s = static_cast<const uint32_t*>(src);
+    int i = 0;
+    for (; i + 4 <= width; i += 4) {
+        v4i32 v = __msa_ld_w((void*)(s + i), 0);
+        __msa_st_w(__msa_splati_w(v, 0), d, 0);
+        __msa_st_w(__msa_splati_w(v, 1), d + 4, 0);
+        __msa_st_w(__msa_splati_w(v, 2), d + 8, 0);
+        __msa_st_w(__msa_splati_w(v, 3), d + 12, 0);
+        d += 16;
+    }
+    row_c_fixed<uint32_t, 4>(d, s + i, width - i, 4);
+}
+#endif
+
+enum :uint32_t {
+    SCALER_ISA_C = 0,
+    SCALER_ISA_SSE2,
+    SCALER_ISA_NEON,
+    SCALER_ISA_MSA,
+};
+
+struct scaler_kernel {
+    uint32_t isa;
+    unsigned bpp;
+    int scale;
+    sdl1_scaler::row_func func;
+    const char *name;
+};
+
+/* ordered by preference, first supported match wins */
+static const scaler_kernel scaler_kernels[] = {
+#ifdef SCALER_USE_MSA
+    {SCALER_ISA_MSA, 16, 2, row_msa_16_2x, "MSA"},
+    {SCALER_ISA_MSA, 16, 3, row_msa_16_3x, "MSA"},
+    {SCALER_ISA_MSA, 16, 4, row_msa_16_4x, "MSA"},
+    {SCALER_ISA_MSA, 32, 2, row_msa_32_2x, "MSA"},
+    {SCALER_ISA_MSA, 32, 3, row_msa_32_3x, "MSA"},
+    {SCALER_ISA_MSA, 32, 4, row_msa_32_4x, "MSA"},
+#endif
+#ifdef SCALER_USE_NEON
+    {SCALER_ISA_NEON, 16, 2, row_neon_16_2x, "NEON"},
+    {SCALER_ISA_NEON, 16, 3, row_neon_16_3x, "NEON"},
+    {SCALER_ISA_NEON, 16, 4, row_neon_16_4x, "NEON"},
+    {SCALER_ISA_NEON, 32, 2, row_neon_32_2x, "NEON"},
+    {SCALER_ISA_NEON, 32, 3, row_neon_32_3x, "NEON"},
+    {SCALER_ISA_NEON, 32, 4, row_neon_32_4x, "NEON"},
+#endif
+#ifdef SCALER_USE_SSE2
+    {SCALER_ISA_SSE2, 16, 2, row_sse2_16_2x, "SSE2"},
+    {SCALER_ISA_SSE2, 16, 3, row_sse2_16_3x, "SSE2"},
+    {SCALER_ISA_SSE2, 16, 4, row_sse2_16_4x, "SSE2"},
+    {SCALER_ISA_SSE2, 32, 2, row_sse2_32_2x, "SSE2"},
+    {SCALER_ISA_SSE2, 32, 3, row_sse2_32_3x, "SSE2"},
+    {SCALER_ISA_SSE2, 32, 4, row_sse2_32_4x, "SSE2"},
+#endif
+    {SCALER_ISA_C, 16, 2, row_c_fixed<uint16_t, 2>, "C"},
+    {SCALER_ISA_C, 16, 3, row_c_fixed<uint16_t, 3>, "C"},
+    {SCALER_ISA_C, 16, 4, row_c_fixed<uint16_t, 4>, "C"},
+    {SCALER_ISA_C, 32, 2, row_c_fixed<uint32_t, 2>, "C"},
+    {SCALER_ISA_C, 32, 3, row_c_fixed<uint32_t, 3>, "C"},
+    {SCALER_ISA_C, 32, 4, row_c_fixed<uint32_t, 4>, "C"},
+};
+
+static bool isa_supported(uint32_t isa) {
+    static uint64_t features = [] {
+        retro_perf_callback cb = {};
+        libretro_get_perf_callback(&cb);
+        return cb.get_cpu_features ? cb.get_cpu_features() : 0ULL;
+    }();
+    switch (isa) {
+    case SCALER_ISA_SSE2:
+#if defined(_M_X64) || defined(__x86_64__)
+        return true;
+#else
+        return (features & RETRO_SIMD_SSE2) != 0;
+#endif
+    case SCALER_ISA_NEON:
+#if defined(__aarch64__)
+        return true;
+#else
+        return (features & RETRO_SIMD_NEON) != 0;
+#endif
+    case SCALER_ISA_MSA:
+#ifdef SCALER_USE_MSA
+        return (getauxval(AT_HWCAP) & HWCAP_MIPS_MSA) != 0;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+bool sdl1_scaler::init(int scale, unsigned bits) {
+    if (row && scale == factor && bits == bpp) return true;
+    row = nullptr;
+    factor = scale;
+    bpp = bits;
+    if (scale < 2 || (bits != 16 && bits != 32)) return false;
+    for (const auto &k: scaler_kernels) {
+        if (k.bpp != bits || k.scale != scale || !isa_supported(k.isa)) continue;
+        row = k.func;
+        LOG(TRACE, "Using {} scaler for {}x on {}bpp surface", k.name, scale, bits);
+        return true;
+    }
+    row = bits == 32 ? row_c<uint32_t> : row_c<uint16_t>;
+    LOG(TRACE, "Using generic scaler for {}x on {}bpp surface", scale, bits);
+    return true;
+}
+
+void sdl1_scaler::scale(void *dst, size_t dst_pitch, const void *src, size_t src_pitch, int width, int height) const {
+    auto line_bytes = static_cast<size_t>(width) * factor * (bpp >> 3u);
+    auto *d = static_cast<uint8_t*>(dst);
+    const auto *s = static_cast<const uint8_t*>(src);
+    for (int y = height; y; --y) {
+        row(d, s, width, factor);
+        const auto *line = d;
+        d += dst_pitch;
+        for (int j = factor - 1; j; --j) {
+            memcpy(d, line, line_bytes);
+            d += dst_pitch;
+        }
+        s += src_pitch;
+    }
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace drivers {
+
+/* nearest-neighbour integer scaler for software surfaces,
+ * each output row is expanded once by a SIMD kernel
+ * and duplicated vertically with memcpy */
+class sdl1_scaler {
+public:
+    /* row kernel: expand `width` pixels from `src` to `width * scale` pixels in `dst` */
+    using row_func = void (*)(void *dst, const void *src, int width, int scale);
+
+    /* select best kernel for scale and bpp (16 or 32) on current cpu,
+     * returns false if scale < 2 or bpp is not supported */
+    bool init(int scale, unsigned bpp);
+    void scale(void *dst, size_t dst_pitch, const void *src, size_t src_pitch, int width, int height) const;
+
+    inline int get_scale() const { return factor; }
+    inline unsigned get_bpp() const { return bpp; }
+
+private:
+    row_func row = nullptr;
+    int factor = 0;
+    unsigned bpp = 0;
+};
+
+}
@@ -1,7 +1,5 @@
 #include "sdl1_ttf.h"
 
-#include "helper.h"
-
 #include <SDL.h>
 
 namespace drivers {
@@ -38,58 +36,30 @@ uint32_t sdl1_ttf::calc_depth_color(SDL_Surface *surface, uint8_t depth) {
 
 void sdl1_ttf::render(SDL_Surface *surface, int x, int y, const char *text, int width, bool shadow) {
     if (surface->format->BitsPerPixel != surface_bpp) {
+        surface_bpp = surface->format->BitsPerPixel;
         depth_color_gen.reset();
     }
     auto rpw = get_rect_pack_width();
 
     bool allow_wrap = false;
-    int nwidth;
-    int ox = x;
     if (width == 0) {
-        width = nwidth = surface->w - x;
+        width = surface->w - x;
     } else if (width == -1) {
-        nwidth = width = surface->w - x;
+        width = surface->w - x;
         allow_wrap = true;
-    } else {
-        if (width < 0) {
-            allow_wrap = true;
-            width = -width;
-            nwidth = width;
-        } else {
-            nwidth = width;
-        }
+    } else if (width < 0) {
+        allow_wrap = true;
+        width = -width;
     }
     int stride = surface->pitch / surface->format->BytesPerPixel;
 
-    while (*text != 0) {
-        uint32_t ch = util::utf8_to_ucs4(text);
-        if (ch == 0 || ch > 0xFFFFu) continue;
-
-        /* Check if bitmap is already cached */
-        const font_data *fd;
-        auto ite = font_cache.find(ch);
-
-        if (ite == font_cache.end()) {
-            fd = make_cache(ch);
-            if (!fd) {
-                continue;
-            }
-        } else {
-            fd = &ite->second;
-            if (fd->advW == 0) continue;
-        }
-        int cwidth = std::max(fd->advW, static_cast<uint8_t>((ch < (1u << 12u)) ? mono_width : mono_width * 2));
-        if (cwidth > nwidth) {
-            if (!allow_wrap) break;
-            x = ox;
-            nwidth = width;
-            y += font_size + 1;
-            if (y + font_size > surface->h)
-                break;
-        }
-        nwidth -= cwidth;
+    const auto &layout = layout_text(text, width, allow_wrap);
+    for (const auto &g: layout.glyphs) {
+        if (g.y && y + g.y + font_size > surface->h)
+            break;
+        const font_data *fd = g.fd;
     #define CODE_WITH_TYPE(TYPE) \
-        TYPE *outptr = static_cast<TYPE*>(surface->pixels) + stride * (y + fd->iy0) + x + fd->ix0; \
+        TYPE *outptr = static_cast<TYPE*>(surface->pixels) + stride * (y + g.y + fd->iy0) + x + g.x + fd->ix0; \
         const uint8_t *input = &pixels[fd->rpidx][fd->rpy * rpw + fd->rpx]; \
         int iw = rpw - fd->w; \
         int ow = stride - fd->w; \
@@ -113,7 +83,6 @@ void sdl1_ttf::render(SDL_Surface *surface, int x, int y, const char *text, int
             CODE_WITH_TYPE(uint16_t)
         }
     #undef CODE_WITH_TYPE
-        x += cwidth;
     }
 }
 
@@ -7,9 +7,30 @@
 #include "helper.h"
 
 #include <SDL.h>
+#include <xxhash.h>
 
 namespace drivers {
 
+enum :int {
+    /* game frame lines per band for dirty tracking */
+    DIRTY_BAND_LINES = 16,
+#ifdef GCW_ZERO
+    PIXEL_FONT_HEIGHT = 8,
+#else
+    PIXEL_FONT_HEIGHT = 16,
+#endif
+};
+
+struct sdl1_osd_cache: osd_cache {
+    ~sdl1_osd_cache() override {
+        if (surface) SDL_FreeSurface(surface);
+    }
+
+    SDL_Surface *surface = nullptr;
+    /* offset from text baseline to top of surface */
+    int top = 0;
+};
+
 const int sdl_video_flags = SDL_SWSURFACE |
 #ifdef SDL_TRIPLEBUF
     SDL_TRIPLEBUF
@@ -21,41 +42,50 @@ const int sdl_video_flags = SDL_SWSURFACE |
 sdl1_video::sdl1_video() {
     SDL_ShowCursor(SDL_DISABLE);
     g_cfg.get_resolution(curr_width, curr_height);
-    curr_pixel_format = 2;
-    screen = SDL_SetVideoMode(curr_width, curr_height, 16, sdl_video_flags);
+    /* use display's native format, only 16 and 32 bpp are supported */
+    const auto *info = SDL_GetVideoInfo();
+    screen_bpp = info && info->vfmt && info->vfmt->BitsPerPixel == 32 ? 32 : 16;
+    update_pixel_format(2);
+    screen = SDL_SetVideoMode(curr_width, curr_height, screen_bpp, sdl_video_flags);
     SDL_LockSurface(screen);
     screen_ptr = screen->pixels;
 
     ttf[0] = std::make_shared<sdl1_ttf>();
     ttf[0]->init(16, 0);
     ttf[0]->add(g_cfg.get_data_dir() + PATH_SEPARATOR_CHAR + "fonts" + PATH_SEPARATOR_CHAR + "regular.ttf", 0);
+    ttf[0]->precache();
     ttf[1] = std::make_shared<sdl1_ttf>();
     ttf[1]->init(16, 0);
     ttf[1]->add(g_cfg.get_data_dir() + PATH_SEPARATOR_CHAR + "fonts" + PATH_SEPARATOR_CHAR + "bold.ttf", 0);
 }
 
 sdl1_video::~sdl1_video() {
+    messages.clear();
     SDL_UnlockSurface(screen);
 }
 
 bool sdl1_video::game_resolution_changed(int width, int height, int max_width, int max_height, unsigned pixel_format) {
-    if (g_cfg.get_scaling_mode() == 0) {
+    /* screen center and bilinear fullscreen keep video mode at configured resolution,
+     * other modes scale the game to video mode size */
+    band_hashes.clear();
+    auto mode = g_cfg.get_scaling_mode();
+    if (mode != 1 && mode != 4) {
         SDL_UnlockSurface(screen);
         usleep(10000);
-        curr_pixel_format = pixel_format;
-        unsigned bpp = pixel_format == 1 ? 32 : 16;
+        update_pixel_format(pixel_format);
         if (width != 0 && height != 0) {
             curr_width = (int)width;
             curr_height = (int)height;
             auto scale = force_scale == 0 ? g_cfg.get_scale() : force_scale;
-            screen = SDL_SetVideoMode(width * scale, height * scale, bpp, sdl_video_flags);
+            screen = SDL_SetVideoMode(width * scale, height * scale, screen_bpp, sdl_video_flags);
         } else {
             g_cfg.get_resolution(curr_width, curr_height);
-            screen = SDL_SetVideoMode(curr_width, curr_height, bpp, sdl_video_flags);
+            screen = SDL_SetVideoMode(curr_width, curr_height, screen_bpp, sdl_video_flags);
         }
         SDL_LockSurface(screen);
         screen_ptr = screen->pixels;
     } else {
+        update_pixel_format(pixel_format);
         curr_width = (int)width;
         curr_height = (int)height;
     }
@@ -79,66 +109,201 @@ void sdl1_video::render(const void *data, int width, int height, size_t pitch) {
     }
     int h = static_cast<int>(height);
     auto scale = g_cfg.get_scale();
-    unsigned bpp = curr_pixel_format == 1 ? 32 : 16;
+    auto mode = g_cfg.get_scaling_mode();
+    full_update = true;
+    if (mode == 4 || (mode >= 2 && scale > 1)) {
+        if (convert_func) {
+            /* convert to screen format first, scalers work on the same format for input and output */
+            size_t conv_pitch = width * (screen_bpp >> 3);
+            convert_buffer.resize(conv_pitch * h);
+            convert_pixels(convert_func, convert_buffer.data(), conv_pitch, data, pitch, width, h);
+            data = convert_buffer.data();
+            pitch = conv_pitch;
+        }
+        if (mode == 4) {
+            render_resampled(data, pitch, width, h);
+        } else if (filter.init(mode - 1, scale, screen_bpp)) {
+            filter.process(screen_ptr, screen->pitch, data, pitch, width, h);
+        } else {
+            scaler.init(scale, screen_bpp);
+            scaler.scale(screen_ptr, screen->pitch, data, pitch, width, h);
+        }
+    } else if (g_cfg.get_dirty_rects() && (screen->flags & (SDL_HWSURFACE | SDL_DOUBLEBUF)) == 0) {
+        render_dirty(data, pitch, width, h, scale);
+    } else {
+        render_lines(data, pitch, width, 0, h, scale);
+    }
+    auto count = active_messages();
+    if (count) {
+        int lh = get_font_size() + 2;
+        int y = mode == 4 ? screen->h - 5 - (int)(count - 1) * lh
+                          : (curr_height - 5 - (int)(count - 1) * lh) * scale;
+        /* blit is not allowed on locked surface */
+        SDL_UnlockSurface(screen);
+        for (auto &m: messages) {
+            if (!message_active(m)) continue;
+            if (!m.cache) {
+                m.cache = render_message(m.text);
+            }
+            auto *surface = static_cast<sdl1_osd_cache*>(m.cache.get())->surface;
+            if (surface) {
+                SDL_Rect rc = {5, static_cast<Sint16>(y + static_cast<sdl1_osd_cache*>(m.cache.get())->top), 0, 0};
+                SDL_BlitSurface(surface, nullptr, screen, &rc);
+            }
+            y += lh;
+        }
+        SDL_LockSurface(screen);
+        screen_ptr = screen->pixels;
+    }
+    messages_drawn = !messages.empty();
+}
+
+std::unique_ptr<osd_cache> sdl1_video::render_message(const std::string &text) {
+    auto cache = std::make_unique<sdl1_osd_cache>();
+    int w, t, b;
+    get_text_width_and_height(text.c_str(), w, t, b);
+    if (!ttf[0]) {
+        /* pixel font is drawn from y - PIXEL_FONT_HEIGHT */
+        t -= PIXEL_FONT_HEIGHT;
+        b -= PIXEL_FONT_HEIGHT;
+    }
+    /* extra pixels for shadow and glyphs exceeding their advance */
+    w = std::min(w + 2, screen->w - 5);
+    int h = b - t + 1;
+    if (w <= 0 || h <= 0) return cache;
+    const auto *fmt = screen->format;
+    auto *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, fmt->BitsPerPixel, fmt->Rmask, fmt->Gmask, fmt->Bmask, 0);
+    if (!surface) return cache;
+    /* text is white/grey with black shadow, magenta never appears */
+    uint32_t key = SDL_MapRGB(surface->format, 0xFF, 0, 0xFF);
+    SDL_FillRect(surface, nullptr, key);
+    SDL_LockSurface(surface);
+    draw_text_surface(surface, 0, -t, text.c_str(), 0, true);
+    SDL_UnlockSurface(surface);
+    SDL_SetColorKey(surface, SDL_SRCCOLORKEY | SDL_RLEACCEL, key);
+    cache->surface = surface;
+    cache->top = t;
+    return cache;
+}
+
+void sdl1_video::render_lines(const void *data, size_t pitch, int width, int y, int lines, int scale) {
+    const auto *input = static_cast<const uint8_t *>(data) + y * pitch;
+    auto *pixels = static_cast<uint8_t *>(screen_ptr) + y * scale * screen->pitch;
+    size_t output_pitch = screen->pitch;
     if (scale == 1) {
-        auto *pixels = static_cast<uint8_t *>(screen_ptr);
-        const auto *input = static_cast<const uint8_t *>(data);
-        int output_pitch = screen->pitch;
-        if (output_pitch == pitch) {
-            memcpy(pixels, input, h * pitch);
+        if (convert_func) {
+            convert_pixels(convert_func, pixels, output_pitch, input, pitch, width, lines);
+        } else if (output_pitch == pitch) {
+            memcpy(pixels, input, lines * pitch);
         } else {
-            int line_bytes = width*(bpp >> 3);
-            for (; h; h--) {
+            int line_bytes = width * (screen_bpp >> 3);
+            for (; lines; lines--) {
                 memcpy(pixels, input, line_bytes);
                 pixels += output_pitch;
                 input += pitch;
             }
         }
-    } else {
-    #define CODE_WITH_TYPE(TYPE) \
-        auto *pixels = static_cast<TYPE*>(screen_ptr); \
-        const auto *input = static_cast<const TYPE*>(data); \
-        int output_pitch = screen->pitch / sizeof(TYPE); \
-        auto s = scale; \
-        auto subp = pitch / sizeof(TYPE) - width; \
-        auto subd = output_pitch - s; \
-        output_pitch *= scale - 1; \
-        for (; h; h--) { \
-            for (unsigned z = width; z; z--) { \
-                auto pix = *input++; \
-                auto *out = pixels; \
-                for (int j = s; j; j--) { \
-                    for (int i = s; i; i--) { \
-                        *out++ = pix; \
-                    } \
-                    out += subd; \
-                } \
-                pixels += s; \
-            } \
-            pixels += output_pitch; \
-            input += subp; \
+        return;
+    }
+    if (convert_func) {
+        /* convert to screen format first, scalers work on the same format for input and output */
+        size_t conv_pitch = width * (screen_bpp >> 3);
+        convert_buffer.resize(conv_pitch * lines);
+        convert_pixels(convert_func, convert_buffer.data(), conv_pitch, input, pitch, width, lines);
+        input = convert_buffer.data();
+        pitch = conv_pitch;
+    }
+    scaler.init(scale, screen_bpp);
+    scaler.scale(pixels, output_pitch, input, pitch, width, lines);
+}
+
+void sdl1_video::render_dirty(const void *data, size_t pitch, int width, int height, int scale) {
+    /* messages are drawn over game frame, redraw all bands while they are shown and once after */
+    bool force = messages_drawn || !messages.empty();
+    auto bands = static_cast<size_t>((height + DIRTY_BAND_LINES - 1) / DIRTY_BAND_LINES);
+    if (band_hashes.size() != bands) {
+        band_hashes.assign(bands, 0);
+        force = true;
+    }
+    size_t line_bytes = width * pixel_format_bytes(curr_pixel_format);
+    dirty_spans.clear();
+    for (size_t i = 0; i < bands; ++i) {
+        int y = static_cast<int>(i) * DIRTY_BAND_LINES;
+        int lines = std::min<int>(DIRTY_BAND_LINES, height - y);
+        const auto *line = static_cast<const uint8_t *>(data) + y * pitch;
+        uint64_t hash;
+        if (pitch == line_bytes) {
+            hash = XXH3_64bits(line, line_bytes * lines);
+        } else {
+            hash = 0;
+            for (int j = lines; j; --j, line += pitch) {
+                hash = XXH3_64bits_withSeed(line, line_bytes, hash);
+            }
         }
-        if (bpp == 32) {
-            CODE_WITH_TYPE(uint32_t)
+        if (!force && hash == band_hashes[i]) continue;
+        band_hashes[i] = hash;
+        render_lines(data, pitch, width, y, lines, scale);
+        /* merge adjacent bands into one rect */
+        int sy = y * scale, sh = lines * scale;
+        if (!dirty_spans.empty() && dirty_spans.back().first + dirty_spans.back().second == sy) {
+            dirty_spans.back().second += sh;
         } else {
-            CODE_WITH_TYPE(uint16_t)
+            dirty_spans.emplace_back(sy, sh);
         }
-    #undef CODE_WITH_TYPE
     }
-    if (!messages.empty()) {
-        uint32_t lh = get_font_size() + 2;
-        uint32_t y = (curr_height - 5 - (messages.size() - 1) * lh) * scale;
-        for (auto &m: messages) {
-            draw_text(5, y, m.first.c_str(), 0, true);
-            y += lh;
+    full_update = false;
+}
+
+void sdl1_video::render_resampled(const void *data, size_t pitch, int width, int height) {
+    /* fit into screen with aspect ratio from core, or square pixels if not provided */
+    float ratio = aspect_ratio > 0.f ? aspect_ratio : (float)width / (float)height;
+    int dw = screen->w;
+    int dh = static_cast<int>((float)dw / ratio + .5f);
+    if (dh > screen->h) {
+        dh = screen->h;
+        dw = std::min<int>(screen->w, static_cast<int>((float)dh * ratio + .5f));
+    }
+    if (!resampler.init(width, height, dw, dh, screen_bpp)) return;
+    size_t bytespp = screen_bpp >> 3;
+    int x = (screen->w - dw) / 2;
+    int y = (screen->h - dh) / 2;
+    auto *pixels = static_cast<uint8_t *>(screen_ptr);
+    /* clear borders every frame as video surface may be multi-buffered */
+    if (y > 0) {
+        memset(pixels, 0, y * screen->pitch);
+        memset(pixels + (y + dh) * screen->pitch, 0, (screen->h - y - dh) * screen->pitch);
+    }
+    if (x > 0) {
+        auto *line = pixels + y * screen->pitch;
+        for (int i = dh; i; --i) {
+            memset(line, 0, x * bytespp);
+            memset(line + (x + dw) * bytespp, 0, (screen->w - x - dw) * bytespp);
+            line += screen->pitch;
         }
     }
+    resampler.process(pixels + y * screen->pitch + x * bytespp, screen->pitch, data, pitch);
 }
 
 void sdl1_video::frame_render() {
-    if (drawn) {
+    if (!drawn) return;
+    if (full_update) {
         flip();
+        return;
+    }
+    std::vector<SDL_Rect> rects;
+    rects.reserve(dirty_spans.size());
+    for (auto &span: dirty_spans) {
+        if (span.first >= screen->h) break;
+        SDL_Rect rc = {0, static_cast<Sint16>(span.first), static_cast<Uint16>(screen->w),
+                       static_cast<Uint16>(std::min<int>(span.second, screen->h - span.first))};
+        rects.push_back(rc);
     }
+    SDL_UnlockSurface(screen);
+    if (!rects.empty()) {
+        SDL_UpdateRects(screen, static_cast<int>(rects.size()), rects.data());
+    }
+    SDL_LockSurface(screen);
+    screen_ptr = screen->pixels;
 }
 
 void *sdl1_video::get_framebuffer(unsigned *width, unsigned *height, size_t *pitch, int *format) {
@@ -146,11 +311,12 @@ void *sdl1_video::get_framebuffer(unsigned *width, unsigned *height, size_t *pit
     *width = screen->w;
     *height = screen->h;
     *pitch = screen->pitch;
-    *format = 2;
+    *format = screen_bpp == 32 ? PIXEL_FORMAT_XRGB8888 : PIXEL_FORMAT_RGB565;
     return screen_ptr;
 }
 
 void sdl1_video::clear() {
+    band_hashes.clear();
     memset(screen_ptr, 0, screen->pitch * screen->h);
 }
 
@@ -224,10 +390,14 @@ void sdl1_video::fill_rectangle(int x, int y, int w, int h) {
 }
 
 void sdl1_video::draw_text(int x, int y, const char *text, int width, bool shadow) {
+    draw_text_surface(screen, x, y, text, width, shadow);
+}
+
+void sdl1_video::draw_text_surface(SDL_Surface *surface, int x, int y, const char *text, int width, bool shadow) {
     if (ttf[0]) {
-        ttf[0]->render(screen, x, y, text, width, shadow);
+        ttf[0]->render(surface, x, y, text, width, shadow);
     } else {
-        draw_text_pixel(x, y, text, width, shadow);
+        draw_text_pixel(surface, x, y, text, width, shadow);
     }
 }
 
@@ -242,23 +412,12 @@ inline const font_data_t &get_pixel_font_data(uint8_t c) {
 }
 
 void sdl1_video::get_text_width_and_height(const char *text, int &w, int &t, int &b) const {
-    w = 0;
-    t = 255;
-    b = -255;
     if (ttf[0]) {
-        while (*text != 0) {
-            uint32_t ch = util::utf8_to_ucs4(text);
-            if (ch == 0 || ch > 0xFFFFu) continue;
-            uint8_t width;
-            int8_t tt, tb;
-            ttf[0]->get_char_width_and_height(ch, width, tt, tb);
-            if (width) {
-                w += width;
-                if (tt < t) t = tt;
-                if (tb > b) b = tb;
-            }
-        }
+        ttf[0]->get_text_width_and_height(text, w, t, b);
     } else {
+        w = 0;
+        t = 255;
+        b = -255;
         while (*text) {
             uint8_t c = *text++;
             if (c > 0x7F) continue;
@@ -270,20 +429,16 @@ void sdl1_video::get_text_width_and_height(const char *text, int &w, int &t, int
     }
 }
 
-void sdl1_video::draw_text_pixel(int x, int y, const char *text, int width, bool shadow) {
+void sdl1_video::draw_text_pixel(SDL_Surface *surface, int x, int y, const char *text, int width, bool shadow) {
     bool allow_wrap = false;
     int nwidth;
     int ox = x;
-#ifdef GCW_ZERO
-    y -= 8;
-#else
-    y -= 16;
-#endif
-    unsigned bpp = curr_pixel_format == 1 ? 32 : 16;
+    y -= PIXEL_FONT_HEIGHT;
+    unsigned bpp = surface->format->BitsPerPixel;
     if (width == 0) {
-        nwidth = width = screen->w - x;
+        nwidth = width = surface->w - x;
     } else if (width == -1) {
-        nwidth = width = screen->w - x;
+        nwidth = width = surface->w - x;
         allow_wrap = true;
     } else {
         if (width < 0) {
@@ -294,7 +449,7 @@ void sdl1_video::draw_text_pixel(int x, int y, const char *text, int width, bool
             nwidth = width;
         }
     }
-    auto swidth = screen->pitch / screen->format->BytesPerPixel;
+    auto swidth = surface->pitch / surface->format->BytesPerPixel;
     while (*text) {
         uint8_t c = *text++;
         if (c > 0x7F) continue;
@@ -303,15 +458,11 @@ void sdl1_video::draw_text_pixel(int x, int y, const char *text, int width, bool
             if (!allow_wrap) break;
             x = ox;
             nwidth = width;
-#ifdef GCW_ZERO
-            y += 8 + 1;
-#else
-            y += 16 + 1;
-#endif
+            y += PIXEL_FONT_HEIGHT + 1;
         }
         nwidth -= fd.sw;
     #define CODE_WITH_TYPE(TYPE) \
-        auto *ptr = (TYPE*)screen_ptr + x + fd.x + (y + fd.y) * swidth; \
+        auto *ptr = (TYPE*)surface->pixels + x + fd.x + (y + fd.y) * swidth; \
         auto *fontdata = fd.data; \
         uint32_t wrapx = swidth - fd.w; \
         uint32_t step = (fd.w + 7) >> 3; \
@@ -364,20 +515,75 @@ void sdl1_video::draw_text_pixel(int x, int y, const char *text, int width, bool
 }
 
 void sdl1_video::gui_popup() {
+    snapshot_menu_bg();
     SDL_UnlockSurface(screen);
     usleep(10000);
     saved_width = curr_width;
     saved_height = curr_height;
     saved_pixel_format = curr_pixel_format;
+    band_hashes.clear();
     g_cfg.get_resolution(curr_width, curr_height);
-    curr_pixel_format = 2;
-    screen = SDL_SetVideoMode(curr_width, curr_height, curr_pixel_format == 1 ? 32 : 16, sdl_video_flags);
+    update_pixel_format(2);
+    screen = SDL_SetVideoMode(curr_width, curr_height, screen_bpp, sdl_video_flags);
     SDL_LockSurface(screen);
     screen_ptr = screen->pixels;
 }
 
 void sdl1_video::gui_leave() {
+    menu_bg.clear();
+    menu_bg.shrink_to_fit();
     game_resolution_changed(saved_width, saved_height, 0, 0, saved_pixel_format);
 }
 
+void sdl1_video::gui_predraw() {
+    if (menu_bg.empty()) return;
+    /* video mode may differ from the one snapshot was taken in, keep it centered */
+    int w = std::min(menu_bg_width, (int)screen->w);
+    int h = std::min(menu_bg_height, (int)screen->h);
+    int sx = (menu_bg_width - w) / 2, sy = (menu_bg_height - h) / 2;
+    int dx = (screen->w - w) / 2, dy = (screen->h - h) / 2;
+    size_t bytes = screen_bpp >> 3;
+    const auto *src = menu_bg.data() + sy * menu_bg_pitch + sx * bytes;
+    auto *dst = static_cast<uint8_t*>(screen_ptr) + dy * screen->pitch + dx * bytes;
+    for (int j = 0; j < h; ++j) {
+        memcpy(dst, src, w * bytes);
+        src += menu_bg_pitch;
+        dst += screen->pitch;
+    }
+}
+
+void sdl1_video::snapshot_menu_bg() {
+    menu_bg_width = screen->w;
+    menu_bg_height = screen->h;
+    menu_bg_pitch = screen->w * (screen_bpp >> 3);
+    menu_bg.resize(menu_bg_pitch * menu_bg_height);
+    /* darken to 3/8 of the original, same as a black overlay with alpha 0xA0 */
+    const auto *src = static_cast<const uint8_t*>(screen_ptr);
+    auto *dst = menu_bg.data();
+    for (int j = 0; j < menu_bg_height; ++j) {
+        if (screen_bpp == 32) {
+            const auto *s = reinterpret_cast<const uint32_t*>(src);
+            auto *d = reinterpret_cast<uint32_t*>(dst);
+            for (int i = 0; i < menu_bg_width; ++i) {
+                uint32_t c = s[i];
+                d[i] = ((c >> 2) & 0x3F3F3FU) + ((c >> 3) & 0x1F1F1FU);
+            }
+        } else {
+            const auto *s = reinterpret_cast<const uint16_t*>(src);
+            auto *d = reinterpret_cast<uint16_t*>(dst);
+            for (int i = 0; i < menu_bg_width; ++i) {
+                uint16_t c = s[i];
+                d[i] = ((c >> 2) & 0x39E7U) + ((c >> 3) & 0x18E3U);
+            }
+        }
+        src += screen->pitch;
+        dst += menu_bg_pitch;
+    }
+}
+
+void sdl1_video::update_pixel_format(uint32_t pixel_format) {
+    curr_pixel_format = pixel_format;
+    convert_func = get_pixel_converter(pixel_format, screen_bpp == 32 ? PIXEL_FORMAT_XRGB8888 : PIXEL_FORMAT_RGB565);
+}
+
 }
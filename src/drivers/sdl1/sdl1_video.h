@@ -2,7 +2,13 @@
 
 #include "video_base.h"
 
+#include "sdl1_scaler.h"
+#include "sdl1_filter.h"
+#include "sdl1_resampler.h"
+#include "pixel_convert.h"
+
 #include <memory>
+#include <vector>
 
 extern "C" {
 typedef struct SDL_Surface SDL_Surface;
@@ -35,11 +41,21 @@ public:
     inline void set_force_scale(uint32_t s) { force_scale = s; }
 
 private:
-    void draw_text_pixel(int x, int y, const char *text, int width, bool shadow);
+    void draw_text_surface(SDL_Surface *surface, int x, int y, const char *text, int width, bool shadow);
+    void draw_text_pixel(SDL_Surface *surface, int x, int y, const char *text, int width, bool shadow);
+    std::unique_ptr<osd_cache> render_message(const std::string &text);
+    void update_pixel_format(uint32_t pixel_format);
+    void render_resampled(const void *data, size_t pitch, int width, int height);
+    /* copy or scale game lines [y, y + lines) to screen */
+    void render_lines(const void *data, size_t pitch, int width, int y, int lines, int scale);
+    void render_dirty(const void *data, size_t pitch, int width, int height, int scale);
+    /* copy current screen content with dimmed colors into menu_bg */
+    void snapshot_menu_bg();
 
 public:
     void gui_popup() override;
     void gui_leave() override;
+    void gui_predraw() override;
 
 private:
     SDL_Surface *screen = nullptr;
@@ -47,15 +63,33 @@ private:
     std::shared_ptr<sdl1_ttf> ttf[2];
     int curr_width = 0, curr_height = 0;
     uint32_t curr_pixel_format = 0;
+    /* native bpp of display, game frames are converted to it */
+    unsigned screen_bpp = 16;
+    pixel_convert_func convert_func = nullptr;
+    std::vector<uint8_t> convert_buffer;
     /* saved previous resolution for use with menu enter/leave */
     int saved_width = 0, saved_height = 0;
     uint32_t saved_pixel_format = 0;
 
     /* override global scale cfg */
     int force_scale = 1;
+    sdl1_scaler scaler;
+    sdl1_filter filter;
+    sdl1_resampler resampler;
 
     uint8_t draw_color[4] = {};
 
+    /* dirty tracking: hash of each band in last game frame, and screen spans (y, h) to update */
+    std::vector<uint64_t> band_hashes;
+    std::vector<std::pair<int, int>> dirty_spans;
+    bool full_update = true;
+    bool messages_drawn = false;
+
+    /* dimmed copy of the paused game screen, drawn as menu background */
+    std::vector<uint8_t> menu_bg;
+    int menu_bg_width = 0, menu_bg_height = 0;
+    size_t menu_bg_pitch = 0;
+
     /* indicate wheather frame was drawn, for auto frameskip use */
     bool drawn = false;
 };
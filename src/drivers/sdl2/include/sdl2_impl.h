@@ -2,6 +2,10 @@
 
 #include "driver_base.h"
 
+extern "C" {
+typedef union SDL_Event SDL_Event;
+}
+
 namespace drivers {
 
 class sdl2_impl: public driver_base {
@@ -11,11 +15,16 @@ public:
     ~sdl2_impl() override;
 
     bool process_events() final;
+    bool wait_events(uint32_t timeout) final;
 
 protected:
     bool init() final;
     void deinit() final;
     void unload() final;
+
+private:
+    /* return true for QUIT event */
+    bool handle_event(const SDL_Event &event);
 };
 
 }
@@ -1,12 +1,19 @@
 #include "sdl2_ttf.h"
 
-#include "helper.h"
-
 #include <glad/glad.h>
 #include <SDL.h>
 
+#include <cmath>
+
 namespace drivers {
 
+sdl2_ttf::sdl2_ttf(uint32_t shader, uint32_t vao, uint32_t vbo, uint32_t uniform):
+    ttf_font_base(true), program_font(shader), vao_font(vao), vbo_font(vbo), uniform_font_color(uniform) {
+    uniform_glyph_rect = glGetUniformLocation(program_font, "glyphRect");
+    uniform_shadow_offset = glGetUniformLocation(program_font, "shadowOffset");
+    uniform_shadow_alpha = glGetUniformLocation(program_font, "shadowAlpha");
+}
+
 sdl2_ttf::~sdl2_ttf() {
     for (auto t: textures) {
         glDeleteTextures(1, &t);
@@ -15,9 +22,9 @@ sdl2_ttf::~sdl2_ttf() {
 }
 
 uint8_t *sdl2_ttf::prepare_texture(size_t index, uint16_t x, uint16_t y, uint16_t w, uint16_t h, int &pitch) {
-    static uint8_t sdata[64 * 64];
     pitch = w;
-    return sdata;
+    upload_buffer.resize(w * h);
+    return upload_buffer.data();
 }
 
 void sdl2_ttf::finish_texture(uint8_t *data, size_t index, uint16_t x, uint16_t y, uint16_t w, uint16_t h, int pitch) {
@@ -29,8 +36,9 @@ void sdl2_ttf::finish_texture(uint8_t *data, size_t index, uint16_t x, uint16_t
         auto rpw = get_rect_pack_width();
         glGenTextures(1, &tex);
         glBindTexture(GL_TEXTURE_2D, tex);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        /* distance fields need linear filter to be scaled smoothly */
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, rpw, rpw, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
         glBindTexture(GL_TEXTURE_2D, 0);
     }
@@ -48,74 +56,44 @@ void sdl2_ttf::set_draw_color(uint8_t r, uint8_t g, uint8_t b) {
 void sdl2_ttf::render(int x, int y, const char *text, int width, int height, bool shadow) {
     if (font_size > height)
         return;
-    int ox = x;
-    int nwidth = width;
     bool allow_wrap = false;
     if (width < 0) {
         allow_wrap = true;
         width = -width;
     }
+    const auto &layout = layout_text(text, width, allow_wrap);
+    int max_y = y + height - font_size;
     auto w = (float)get_rect_pack_width();
+    auto scale = get_scale();
+    /* shadow is drawn in the same pass by sampling the distance field at an offset,
+     * glyph quads are extended to cover it */
+    auto shadow_offset = shadow ? std::max(1.f, (float)font_size / 8.f) : 0.f;
+    auto shadow_tex = shadow_offset / scale / w;
     glUseProgram(program_font);
     glBindVertexArray(vao_font);
-    while (*text != 0) {
-        uint32_t ch = helper::utf8_to_ucs4(text);
-        if (ch == 0 || ch > 0xFFFFu) continue;
-
-        const font_data *fd;
-        auto ite = font_cache.find(ch);
-        if (ite == font_cache.end()) {
-            fd = make_cache(ch);
-            if (!fd) {
-                continue;
-            }
-        } else {
-            fd = &ite->second;
-            if (fd->advW == 0) continue;
-        }
-
-        int cwidth = mono_width ? std::max(fd->w, mono_width) : fd->w;
-        if (cwidth > nwidth) {
-            if (!allow_wrap) break;
-            x = ox;
-            nwidth = width;
-            y += font_size + 1;
-            height -= font_size;
-            if (y > height)
-                break;
-        }
+    glUniform3fv(uniform_font_color, 1, color);
+    glUniform2f(uniform_shadow_offset, shadow_tex, shadow_tex);
+    glUniform1f(uniform_shadow_alpha, shadow ? 1.f : 0.f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_font);
+    for (const auto &g: layout.glyphs) {
+        if (y + g.y > max_y) break;
+        const auto *fd = g.fd;
+        if (!fd->w || !fd->h) continue;
 
         auto sx0 = (float)fd->rpx / w;
         auto sy0 = (float)fd->rpy / w;
-        auto sx1 = (float)(fd->rpx + fd->w) / w;
-        auto sy1 = (float)(fd->rpy + fd->h) / w;
-        auto x0 = (float)(x + fd->ix0);
-        auto y0 = (float)(y + fd->iy0);
-        auto x1 = x0 + (float)fd->w;
-        auto y1 = y0 + (float)fd->h;
+        auto sx1 = (float)(fd->rpx + fd->w) / w + shadow_tex;
+        auto sy1 = (float)(fd->rpy + fd->h) / w + shadow_tex;
+        auto x0 = (float)(x + g.x) + (float)fd->ix0 * scale;
+        auto y0 = (float)(y + g.y) + (float)fd->iy0 * scale;
+        auto x1 = x0 + (float)fd->w * scale + shadow_offset;
+        auto y1 = y0 + (float)fd->h * scale + shadow_offset;
 
-        glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, textures[fd->rpidx]);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_font);
-        if (shadow) {
-            auto shx0 = x0 + 2.f;
-            auto shx1 = x1 + 2.f;
-            auto shy0 = y0 + 2.f;
-            auto shy1 = y1 + 2.f;
-            float vertices[] = {
-                shx0, shy0, sx0, sy0, // top left
-                shx1, shy0, sx1, sy0, // top right
-                shx0, shy1, sx0, sy1, // bottom left
-                shx1, shy1, sx1, sy1  // bottom right
-            };
-            glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-            glEnableVertexAttribArray(0);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-            glUniform3f(uniform_font_color, 0.f, 0.f, 0.f);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        }
+        /* keep samples inside the glyph, never read neighbours in atlas */
+        glUniform4f(uniform_glyph_rect, ((float)fd->rpx + .5f) / w, ((float)fd->rpy + .5f) / w,
+                    ((float)(fd->rpx + fd->w) - .5f) / w, ((float)(fd->rpy + fd->h) - .5f) / w);
         float vertices[] = {
             x0, y0, sx0, sy0, // top left
             x1, y0, sx1, sy0, // top right
@@ -127,10 +105,7 @@ void sdl2_ttf::render(int x, int y, const char *text, int width, int height, boo
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
         glEnableVertexAttribArray(1);
-        glUniform3fv(uniform_font_color, 1, color);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        x += fd->advW;
-        nwidth -= fd->advW;
     }
 }
 
@@ -6,7 +6,7 @@ namespace drivers {
 
 class sdl2_ttf: public ttf_font_base {
 public:
-    inline sdl2_ttf(uint32_t shader, uint32_t vao, uint32_t vbo, uint32_t uniform): program_font(shader), vao_font(vao), vbo_font(vbo), uniform_font_color(uniform) {}
+    sdl2_ttf(uint32_t shader, uint32_t vao, uint32_t vbo, uint32_t uniform);
     ~sdl2_ttf() override;
 
     void set_draw_color(uint8_t r, uint8_t g, uint8_t b) override;
@@ -18,7 +18,9 @@ protected:
 
 private:
     std::vector<uint32_t> textures;
+    std::vector<uint8_t> upload_buffer;
     uint32_t program_font, vao_font, vbo_font, uniform_font_color;
+    uint32_t uniform_glyph_rect, uniform_shadow_offset, uniform_shadow_alpha;
     float color[3] = {1.f, 1.f, 1.f};
 };
 
@@ -16,6 +16,17 @@
 
 namespace drivers {
 
+struct sdl2_osd_cache: osd_cache {
+    ~sdl2_osd_cache() override {
+        if (texture) glDeleteTextures(1, &texture);
+    }
+
+    uint32_t texture = 0;
+    int width = 0, height = 0;
+    /* offset from text baseline to top of texture */
+    int top = 0;
+};
+
 inline uint32_t compile_shader(const std::string &vertex_shader_source,
                                const std::string &fragment_shader_source) {
     uint32_t vertex_shader = glCreateShader(GL_VERTEX_SHADER);
@@ -204,7 +215,11 @@ void sdl2_video::window_resized(int width, int height, bool fullscreen) {
     }
     gl_set_ortho();
     init_fonts();
+    clear_message_cache();
     recalc_draw_rect();
+    if (gl_renderer.texture_menu_bg) {
+        gl_renderer_snapshot_menu_bg();
+    }
 }
 
 bool sdl2_video::game_resolution_changed(int width, int height, int max_width, int max_height, uint32_t pixel_format) {
@@ -217,6 +232,8 @@ bool sdl2_video::game_resolution_changed(int width, int height, int max_width, i
         game_pixel_format = pixel_format;
         bpp = pixel_format == 1 ? 4 : 2;
     }
+    /* 0RGB1555 is not uploadable on GLES, convert it to RGB565 */
+    convert_func = pixel_format == PIXEL_FORMAT_0RGB1555 ? get_pixel_converter(pixel_format, PIXEL_FORMAT_RGB565) : nullptr;
     recalc_draw_rect(pixel_format_changed);
     return true;
 }
@@ -236,6 +253,13 @@ void sdl2_video::render(const void *data, int width, int height, size_t pitch) {
         }
     }
     if (data != nullptr && data != RETRO_HW_FRAME_BUFFER_VALID) {
+        if (convert_func) {
+            size_t conv_pitch = width * 2;
+            convert_buffer.resize(conv_pitch * height);
+            convert_pixels(convert_func, convert_buffer.data(), conv_pitch, data, pitch, width, height);
+            data = convert_buffer.data();
+            pitch = conv_pitch;
+        }
         if (!gl_renderer_gen_texture(data, pitch / bpp)) {
             drawn = false;
             return;
@@ -256,13 +280,16 @@ void sdl2_video::frame_render() {
     glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    if (!messages.empty()) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        uint32_t lh = ttf[0]->get_font_size() + 2;
-        uint32_t y = curr_height - 5 - (messages.size() - 1) * lh;
+    auto count = active_messages();
+    if (count) {
+        int lh = ttf[0]->get_font_size() + 2;
+        int y = curr_height - 5 - (int)(count - 1) * lh;
         for (auto &m: messages) {
-            draw_text(5, y, m.first.c_str(), 0, true);
+            if (!message_active(m)) continue;
+            if (!m.cache) {
+                m.cache = gl_renderer_render_message(m.text);
+            }
+            gl_renderer_draw_message(*static_cast<const sdl2_osd_cache*>(m.cache.get()), 5, y);
             y += lh;
         }
     }
@@ -350,39 +377,49 @@ void sdl2_video::draw_text(int x, int y, const char *text, int width, bool shado
 }
 
 void sdl2_video::get_text_width_and_height(const char *text, int &w, int &t, int &b) const {
-    w = 0;
-    t = 255;
-    b = -255;
-    while (*text != 0) {
-        uint32_t ch = helper::utf8_to_ucs4(text);
-        if (ch == 0 || ch > 0xFFFFu) continue;
-        uint8_t width;
-        int8_t tt, tb;
-        ttf[0]->get_char_width_and_height(ch, width, tt, tb);
-        if (width) {
-            w += width;
-            if (tt < t) t = tt;
-            if (tb > b) b = tb;
-        }
-    }
+    ttf[0]->get_text_width_and_height(text, w, t, b);
 }
 
-void sdl2_video::gui_predraw() {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+void sdl2_video::gui_popup() {
+    gl_renderer_snapshot_menu_bg();
+}
+
+void sdl2_video::gui_leave() {
+    gl_renderer_free_menu_bg();
+}
 
+void sdl2_video::gui_predraw() {
+    if (!gl_renderer.texture_menu_bg) {
+        gl_renderer_snapshot_menu_bg();
+        if (!gl_renderer.texture_menu_bg) return;
+    }
+    /* texture is rendered upside down in framebuffer coordinates */
+    float vertices[] = {
+        -1.f,  1.f, 0.f, 1.f, // top left
+         1.f,  1.f, 1.f, 1.f, // top right
+        -1.f, -1.f, 0.f, 0.f, // bottom left
+         1.f, -1.f, 1.f, 0.f  // bottom right
+    };
+    glDisable(GL_BLEND);
     glUseProgram(gl_renderer.program_texture);
-    glBindVertexArray(gl_renderer.vao_texture);
+    glBindVertexArray(gl_renderer.vao_osd);
+    glBindBuffer(GL_ARRAY_BUFFER, gl_renderer.vbo_osd);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
+    glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_menu_bg);
     glViewport(0, 0, curr_width, curr_height);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
     glUseProgram(0);
 
-    set_draw_color(0, 0, 0, 0xA0);
-    fill_rectangle(0, 0, curr_width, curr_height);
+    /* menu elements are drawn with alpha blending */
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 void sdl2_video::config_changed() {
@@ -391,6 +428,9 @@ void sdl2_video::config_changed() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, g_cfg.get_linear() ? GL_LINEAR : GL_NEAREST);
     glBindTexture(GL_TEXTURE_2D, 0);
     game_width = game_height = 0;
+    if (gl_renderer.texture_menu_bg) {
+        gl_renderer_snapshot_menu_bg();
+    }
 }
 
 bool sdl2_video::init_video(bool use_gles) {
@@ -462,6 +502,7 @@ bool sdl2_video::init_video(bool use_gles) {
 }
 
 void sdl2_video::deinit_video() {
+    clear_message_cache();
     if (ttf[0]) {
         ttf[0].reset();
     }
@@ -483,19 +524,18 @@ void sdl2_video::deinit_video() {
 }
 
 void sdl2_video::init_fonts() {
-    if (ttf[0]) {
-        ttf[0]->deinit();
-    } else {
-        ttf[0] = std::make_shared<sdl2_ttf>(gl_renderer.program_font, gl_renderer.vao_font, gl_renderer.vbo_font, gl_renderer.uniform_font_color);
-    }
-    if (ttf[1]) {
-        ttf[1]->deinit();
-    } else {
-        ttf[1] = std::make_shared<sdl2_ttf>(gl_renderer.program_font, gl_renderer.vao_font, gl_renderer.vbo_font, gl_renderer.uniform_font_color);
+    int size = std::min(16 * curr_width / 640, 16 * curr_height / 480) & ~1;
+    /* glyphs are distance fields, just rescale them instead of rebuilding the atlas */
+    if (ttf[0] && ttf[1]) {
+        ttf[0]->set_font_size(size);
+        ttf[1]->set_font_size(size);
+        return;
     }
-    auto size = std::min(16 * curr_width / 640, 16 * curr_height / 480) & ~1u;
+    ttf[0] = std::make_shared<sdl2_ttf>(gl_renderer.program_font, gl_renderer.vao_font, gl_renderer.vbo_font, gl_renderer.uniform_font_color);
+    ttf[1] = std::make_shared<sdl2_ttf>(gl_renderer.program_font, gl_renderer.vao_font, gl_renderer.vbo_font, gl_renderer.uniform_font_color);
     ttf[0]->init(size, 0);
     ttf[0]->add(g_cfg.get_data_dir() + PATH_SEPARATOR_CHAR + "fonts" + PATH_SEPARATOR_CHAR + "regular.ttf", 0);
+    ttf[0]->precache();
     ttf[1]->init(size, 0);
     ttf[1]->add(g_cfg.get_data_dir() + PATH_SEPARATOR_CHAR + "fonts" + PATH_SEPARATOR_CHAR + "bold.ttf", 0);
 }
@@ -563,9 +603,18 @@ void sdl2_video::init_opengl() {
         "in vec2 texCoord;\n"
         "uniform sampler2D texture0;\n"
         "uniform vec3 outColor;\n"
+        "uniform vec4 glyphRect;\n"
+        "uniform vec2 shadowOffset;\n"
+        "uniform float shadowAlpha;\n"
         "void main()\n"
         "{\n"
-        "  fragColor = vec4(outColor, texture(texture0, texCoord).r);\n"
+        "  float dist = texture(texture0, clamp(texCoord, glyphRect.xy, glyphRect.zw)).r;\n"
+        "  float sdist = texture(texture0, clamp(texCoord - shadowOffset, glyphRect.xy, glyphRect.zw)).r;\n"
+        "  float edge = max(fwidth(dist) * 0.7, 0.001);\n"
+        "  float a = smoothstep(0.5 - edge, 0.5 + edge, dist);\n"
+        "  float sa = smoothstep(0.5 - edge, 0.5 + edge, sdist) * shadowAlpha * (1.0 - a);\n"
+        "  float alpha = a + sa;\n"
+        "  fragColor = vec4(outColor * (a / max(alpha, 0.001)), alpha);\n"
         "}");
 
     gl_renderer.bottom_left = false;
@@ -578,6 +627,9 @@ void sdl2_video::init_opengl() {
     glGenVertexArrays(1, &gl_renderer.vao_font);
     glGenBuffers(1, &gl_renderer.vbo_font);
 
+    glGenVertexArrays(1, &gl_renderer.vao_osd);
+    glGenBuffers(1, &gl_renderer.vbo_osd);
+
     glGenTextures(1, &gl_renderer.texture_game);
     glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, g_cfg.get_linear() ? GL_LINEAR : GL_NEAREST);
@@ -596,6 +648,7 @@ void sdl2_video::init_opengl() {
 }
 
 void sdl2_video::deinit_opengl() {
+    gl_renderer_free_menu_bg();
     if (gl_renderer.texture_game) {
         glDeleteTextures(1, &gl_renderer.texture_game);
         gl_renderer.texture_game = 0;
@@ -610,6 +663,15 @@ void sdl2_video::deinit_opengl() {
         gl_renderer.vao_font = 0;
     }
 
+    if (gl_renderer.vbo_osd) {
+        glDeleteBuffers(1, &gl_renderer.vbo_osd);
+        gl_renderer.vbo_osd = 0;
+    }
+    if (gl_renderer.vao_osd) {
+        glDeleteVertexArrays(1, &gl_renderer.vao_osd);
+        gl_renderer.vao_osd = 0;
+    }
+
     if (gl_renderer.vbo_texture) {
         glDeleteBuffers(1, &gl_renderer.vbo_texture);
         gl_renderer.vbo_texture = 0;
@@ -722,9 +784,6 @@ void sdl2_video::gl_renderer_update_texture_rect(bool force_create_empty_texture
 void sdl2_video::gl_renderer_create_empty_texture() const {
     glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
     switch (game_pixel_format) {
-    case 0:
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gl_renderer.texture_w, gl_renderer.texture_h, 0, GL_BGRA, GL_UNSIGNED_SHORT_5_5_5_1, nullptr);
-        break;
     case 1:
         if (gl_renderer.use_gles) {
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gl_renderer.texture_w, gl_renderer.texture_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
@@ -783,10 +842,8 @@ bool sdl2_video::gl_renderer_gen_texture(const void *data, size_t pitch) const {
     glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
     glBlendFunc(GL_ONE, GL_ZERO);
+    /* 0RGB1555 is converted to RGB565 in render() */
     switch (game_pixel_format) {
-    case 0:
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, game_width, game_height, GL_BGRA, GL_UNSIGNED_SHORT_5_5_5_1, data);
-        break;
     case 1:
         if (gl_renderer.use_gles) {
             glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, game_width, game_height, GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -803,4 +860,130 @@ bool sdl2_video::gl_renderer_gen_texture(const void *data, size_t pitch) const {
     return true;
 }
 
+std::unique_ptr<osd_cache> sdl2_video::gl_renderer_render_message(const std::string &text) {
+    auto cache = std::make_unique<sdl2_osd_cache>();
+    int w, t, b;
+    ttf[0]->get_text_width_and_height(text.c_str(), w, t, b);
+    /* same shadow offset as sdl2_ttf::render, plus a pixel for glyphs exceeding their advance */
+    int shadow = (int)std::ceil(std::max(1.f, (float)ttf[0]->get_font_size() / 8.f)) + 1;
+    w = std::min(w + shadow, curr_width - 5);
+    int h = b - t + shadow;
+    if (w <= 0 || h <= 0) return cache;
+
+    glGenTextures(1, &cache->texture);
+    glBindTexture(GL_TEXTURE_2D, cache->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uint32_t fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cache->texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        mat4f proj_mat;
+        gl_ortho_mat(proj_mat, 0.0f, (float)w, (float)h, 0.0f, 0.0f, 1.0f);
+        glUseProgram(gl_renderer.program_font);
+        glUniformMatrix4fv(glGetUniformLocation(gl_renderer.program_font, "projMat"), 1, GL_FALSE, proj_mat);
+        glViewport(0, 0, w, h);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        /* store premultiplied alpha so the texture can be blended as-is later */
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        ttf[0]->render(0, -t, text.c_str(), w, h + ttf[0]->get_font_size(), true);
+        cache->width = w;
+        cache->height = h;
+        cache->top = t;
+    } else {
+        glDeleteTextures(1, &cache->texture);
+        cache->texture = 0;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glViewport(0, 0, curr_width, curr_height);
+    gl_set_ortho();
+    return cache;
+}
+
+void sdl2_video::gl_renderer_draw_message(const sdl2_osd_cache &cache, int x, int y) const {
+    if (!cache.texture) return;
+    y += cache.top;
+    float x0 = (float)x * 2.f / (float)curr_width - 1.f;
+    float y0 = 1.f - (float)y * 2.f / (float)curr_height;
+    float x1 = (float)(x + cache.width) * 2.f / (float)curr_width - 1.f;
+    float y1 = 1.f - (float)(y + cache.height) * 2.f / (float)curr_height;
+    /* texture is rendered upside down in framebuffer coordinates */
+    float vertices[] = {
+        x0, y0, 0.f, 1.f, // top left
+        x1, y0, 1.f, 1.f, // top right
+        x0, y1, 0.f, 0.f, // bottom left
+        x1, y1, 1.f, 0.f  // bottom right
+    };
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(gl_renderer.program_texture);
+    glBindVertexArray(gl_renderer.vao_osd);
+    glBindBuffer(GL_ARRAY_BUFFER, gl_renderer.vbo_osd);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STREAM_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, cache.texture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+void sdl2_video::gl_renderer_snapshot_menu_bg() {
+    if (curr_width <= 0 || curr_height <= 0) return;
+    if (!gl_renderer.texture_menu_bg) {
+        glGenTextures(1, &gl_renderer.texture_menu_bg);
+    }
+    glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_menu_bg);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, curr_width, curr_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uint32_t fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl_renderer.texture_menu_bg, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        glViewport(0, 0, curr_width, curr_height);
+        glClearColor(0.f, 0.f, 0.f, 1.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glDisable(GL_BLEND);
+        glUseProgram(gl_renderer.program_texture);
+        glBindVertexArray(gl_renderer.vao_texture);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, gl_renderer.texture_game);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glUseProgram(0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        set_draw_color(0, 0, 0, 0xA0);
+        fill_rectangle(0, 0, curr_width, curr_height);
+    } else {
+        glDeleteTextures(1, &gl_renderer.texture_menu_bg);
+        gl_renderer.texture_menu_bg = 0;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+}
+
+void sdl2_video::gl_renderer_free_menu_bg() {
+    if (gl_renderer.texture_menu_bg) {
+        glDeleteTextures(1, &gl_renderer.texture_menu_bg);
+        gl_renderer.texture_menu_bg = 0;
+    }
+}
+
 }
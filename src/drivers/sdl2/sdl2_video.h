@@ -1,8 +1,10 @@
 #pragma once
 
 #include "video_base.h"
+#include "pixel_convert.h"
 
 #include <memory>
+#include <vector>
 
 extern "C" {
 typedef struct SDL_Window SDL_Window;
@@ -12,6 +14,7 @@ typedef void *SDL_GLContext;
 namespace drivers {
 
 class sdl2_ttf;
+struct sdl2_osd_cache;
 
 class sdl2_video: public video_base {
 public:
@@ -43,6 +46,8 @@ public:
     void draw_text(int x, int y, const char *text, int width, bool shadow) override;
     void get_text_width_and_height(const char *text, int &w, int &t, int &b) const override;
 
+    void gui_popup() override;
+    void gui_leave() override;
     void gui_predraw() override;
     void config_changed() override;
 
@@ -61,6 +66,12 @@ private:
     void gl_renderer_create_empty_texture() const;
     bool gl_renderer_resized(float wratio, float hratio) const;
     bool gl_renderer_gen_texture(const void *data, size_t pitch) const;
+    /* render message into a texture once, then draw it as a quad every frame */
+    std::unique_ptr<osd_cache> gl_renderer_render_message(const std::string &text);
+    void gl_renderer_draw_message(const sdl2_osd_cache &cache, int x, int y) const;
+    /* render dimmed game frame into texture_menu_bg, so menu redraws need only one quad for background */
+    void gl_renderer_snapshot_menu_bg();
+    void gl_renderer_free_menu_bg();
 
 private:
     SDL_Window *window = nullptr;
@@ -71,7 +82,9 @@ private:
         uint32_t vao_draw = 0, vbo_draw = 0;
         uint32_t vao_texture = 0, vbo_texture = 0;
         uint32_t vao_font = 0, vbo_font = 0;
+        uint32_t vao_osd = 0, vbo_osd = 0;
         uint32_t texture_game = 0;
+        uint32_t texture_menu_bg = 0;
         uint32_t texture_w = 0, texture_h = 0;
         uint32_t uniform_font_color = 0;
         float draw_color[4] = {1.f, 1.f, 1.f, 1.f};
@@ -83,6 +96,9 @@ private:
     size_t bpp = 2;
     int game_width = 0, game_height = 0, game_max_width = 0, game_max_height = 0;
     uint32_t game_pixel_format = 0;
+    /* converter for pixel formats not supported by texture upload */
+    pixel_convert_func convert_func = nullptr;
+    std::vector<uint8_t> convert_buffer;
     int saved_x, saved_y;
 
     /* ttf[0] is regular font
@@ -43,10 +43,23 @@ protected:
     bool core_settings_menu(menu_base *parent);
     bool input_settings_menu(menu_base *parent);
     bool language_settings_menu(menu_base *parent);
+    bool cheat_search_menu(menu_base *parent);
+    bool cheats_menu(menu_base *parent);
 
 private:
     std::shared_ptr<drivers::driver_base> driver;
 
+    /* cheat search options, kept between menu calls */
+    struct cheat_search_options {
+        uint32_t size_index = 0;
+        bool is_signed = false;
+        bool big_endian = false;
+        uint32_t compare = 0;
+        uint32_t compare_with = 0;
+        int64_t value = 0;
+        uint32_t step_index = 0;
+    } search_opts;
+
 #ifdef CORE_DOWNLOADER
     util::Downloader downloader;
 #endif
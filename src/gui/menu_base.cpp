@@ -9,6 +9,14 @@
 
 namespace gui {
 
+enum :uint32_t {
+    /* max wait time for events while idle, in ms */
+    MENU_IDLE_TIMEOUT = 1000,
+    /* key repeat delay and interval for held navigation buttons, in ms */
+    MENU_REPEAT_DELAY = 300,
+    MENU_REPEAT_INTERVAL = 60,
+};
+
 menu_base::menu_base(const std::shared_ptr<drivers::driver_base> &d, menu_base *p, std::function<void(menu_base&)> init_func) : gui_base(d, p), init_fn(std::move(init_func)) {
 }
 
@@ -24,25 +32,17 @@ void menu_base::event_loop() {
         if (init_fn)
             init_fn(*this);
         running = true;
-        do {
-            if (driver->process_events()) {
-                ok_pressed = false;
-                leave_event_loop();
-                driver->shutdown();
-                break;
-            }
-            input->input_poll();
-            usleep(50000);
-        } while (input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK) != 0);
-        if (!running) {
+        if (!wait_for_release()) {
+            ok_pressed = false;
+            leave_event_loop();
+            driver->shutdown();
             break;
         }
         init();
         set_selected(sel);
         draw();
         while (running && !force_refreshing) {
-            usleep(50000);
-            if (driver->process_events()) {
+            if (driver->wait_events(next_timeout())) {
                 ok_pressed = false;
                 leave_event_loop();
                 driver->shutdown();
@@ -50,7 +50,6 @@ void menu_base::event_loop() {
             }
             if (poll_input() && running && !force_refreshing) {
                 draw();
-                usleep(100000);
             }
         }
         sel = selected;
@@ -176,6 +175,26 @@ void menu_base::set_selected(size_t sel) {
     }
 }
 
+bool menu_base::wait_for_release() {
+    auto *input = driver->get_input();
+    if (driver->process_events()) return false;
+    input->input_poll();
+    while (input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK) != 0) {
+        if (driver->wait_events(MENU_IDLE_TIMEOUT)) return false;
+        input->input_poll();
+    }
+    last_states = 0;
+    repeat_button = -1;
+    return true;
+}
+
+uint32_t menu_base::next_timeout() const {
+    if (repeat_button < 0) return MENU_IDLE_TIMEOUT;
+    auto now = helper::get_ticks_usec();
+    if (now >= repeat_time) return 0;
+    return static_cast<uint32_t>((repeat_time - now + 999ULL) / 1000ULL);
+}
+
 bool menu_base::poll_input() {
     auto *input = driver->get_input();
     input->input_poll();
@@ -202,7 +221,27 @@ bool menu_base::poll_input() {
         input->set_input_mode(drivers::input_base::mode_menu);
         return true;
     }
-    auto states = input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK);
+    uint64_t states = input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK);
+    /* act on newly pressed buttons only, held navigation buttons repeat on timer */
+    uint64_t pressed = states & ~last_states;
+    last_states = states;
+    if (repeat_button >= 0) {
+        if (!(states & (1ULL << repeat_button))) {
+            repeat_button = -1;
+        } else if (!pressed && helper::get_ticks_usec() >= repeat_time) {
+            pressed = 1ULL << repeat_button;
+            repeat_time = helper::get_ticks_usec() + MENU_REPEAT_INTERVAL * 1000ULL;
+        }
+    }
+    for (int id: {RETRO_DEVICE_ID_JOYPAD_UP, RETRO_DEVICE_ID_JOYPAD_DOWN, RETRO_DEVICE_ID_JOYPAD_LEFT,
+                  RETRO_DEVICE_ID_JOYPAD_RIGHT, RETRO_DEVICE_ID_JOYPAD_L, RETRO_DEVICE_ID_JOYPAD_R}) {
+        if ((pressed & (1ULL << id)) && id != repeat_button) {
+            repeat_button = id;
+            repeat_time = helper::get_ticks_usec() + MENU_REPEAT_DELAY * 1000ULL;
+            break;
+        }
+    }
+    states = pressed;
     if (states & (1<<RETRO_DEVICE_ID_JOYPAD_UP)) {
         move_up();
         return true;
@@ -244,17 +283,22 @@ bool menu_base::poll_input() {
                     running = false;
                     return false;
                 }
+                /* callback may run a sub-menu, do not take buttons still held from there as new presses */
+                input->input_poll();
+                last_states = input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK);
+                repeat_button = -1;
                 return true;
             }
             ok_pressed = true;
             running = false;
             return false;
         case menu_input:
-            do {
-                driver->process_events();
-                input->input_poll();
-                usleep(50000);
-            } while(input->input_state(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_MASK) != 0);
+            if (!wait_for_release()) {
+                ok_pressed = false;
+                leave_event_loop();
+                driver->shutdown();
+                return false;
+            }
             input->clear_last_input();
             input->set_input_mode(drivers::input_base::mode_input);
             in_input_mode = true;
@@ -95,6 +95,10 @@ public:
 protected:
     /* poll all inputs, return true if any changes to the menu (aka redraw is required) */
     bool poll_input();
+    /* block until all joypad buttons are released, return false on QUIT event */
+    bool wait_for_release();
+    /* time to wait for events before next key repeat is due, in ms */
+    uint32_t next_timeout() const;
 
     inline void set_ok_pressed(bool b) { ok_pressed = b; }
     /* return maximum count for items for a page */
@@ -116,6 +120,11 @@ private:
     bool ok_pressed = false;
     bool force_refreshing = false;
 
+    /* joypad states of last poll, and held navigation button for key repeat */
+    uint64_t last_states = 0;
+    int repeat_button = -1;
+    uint64_t repeat_time = 0;
+
     std::function<void(menu_base&)> init_fn;
 };
 
@@ -12,6 +12,10 @@
 #include "libretro.h"
 #include "variables.h"
 #include "core_manager.h"
+#include "cheat_search.h"
+#include "cheat_engine.h"
+
+#include <fmt/format.h>
 
 namespace gui {
 
@@ -56,6 +60,10 @@ void ui_host::in_game_menu() {
             {menu_static, "Input Settings"_i18n, "", 0, {},
                 [this, &menu](const menu_item &item) { return input_settings_menu(&menu); }},
 #endif
+            {menu_static, "Cheats"_i18n, "", 0, {},
+                [this, &menu](const menu_item &item) { return cheats_menu(&menu); }},
+            {menu_static, "Cheat Search"_i18n, "", 0, {},
+                [this, &menu](const menu_item &item) { return cheat_search_menu(&menu); }},
             {menu_static, "Language"_i18n, "", 0, {},
                 [this, &menu](const menu_item &item) { return language_settings_menu(&menu); }},
             {menu_static, "Reset Game"_i18n, "", 0, {}, [this](const menu_item &) {
@@ -73,6 +81,16 @@ void ui_host::in_game_menu() {
             /* remove `Core Settings` from menu */
             items.erase(items.begin() + 1);
         }
+        if (driver->get_cheats()->get_cheats().empty()) {
+            /* remove `Cheats` from menu */
+            items.erase(items.end() - 5);
+        }
+        std::vector<::libretro::memory_region> regions;
+        driver->get_memory_regions(regions);
+        if (regions.empty()) {
+            /* remove `Cheat Search` from menu */
+            items.erase(items.end() - 4);
+        }
         if (global_language_list.size() < 2) {
             items.erase(items.end() - 3);
         }
@@ -141,6 +159,22 @@ bool ui_host::global_settings_menu(menu_base *parent) {
                     return false;
                 }
             },
+#endif
+#if SDLRETRO_FRONTEND == 1
+            {menu_values, "Scaling Mode"_i18n, "", std::min<size_t>(g_cfg.get_scaling_mode(), 4),
+                {"IPU Scaling"_i18n, "Screen Center"_i18n, "Scale2x/Scale3x", "xBR-lite", "Bilinear Fullscreen"_i18n},
+                [](const menu_item &item) -> bool {
+                    g_cfg.set_scaling_mode(static_cast<uint32_t>(item.selected));
+                    return false;
+                }
+            },
+            {menu_boolean, "Dirty Rectangles"_i18n, "", static_cast<size_t>(g_cfg.get_dirty_rects() ? 1 : 0),
+                {},
+                [](const menu_item &item) -> bool {
+                    g_cfg.set_dirty_rects(item.selected != 0);
+                    return false;
+                }
+            },
 #endif
         };
         menu.set_items(items);
@@ -276,6 +310,134 @@ bool ui_host::language_settings_menu(menu_base *parent) {
     return false;
 }
 
+bool ui_host::cheat_search_menu(menu_base *parent) {
+    enum :size_t {
+        search_sizes_count = 3,
+        value_steps_count = 7,
+        /* results listed in menu */
+        search_results_max = 100,
+    };
+    static const ::libretro::cheat_search::value_size search_sizes[search_sizes_count] = {
+        ::libretro::cheat_search::size_8, ::libretro::cheat_search::size_16, ::libretro::cheat_search::size_32
+    };
+    static const int64_t value_steps[value_steps_count] = {1, 10, 100, 1000, 10000, 0x100, 0x10000};
+
+    auto *finder = driver->get_cheat_search();
+    sdl_menu menu(driver, parent, [this, finder](menu_base &menu) {
+        menu.set_title(std::string("[") + "Cheat Search"_i18n + "]");
+
+        if (search_opts.size_index >= search_sizes_count) search_opts.size_index = 0;
+        if (search_opts.step_index >= value_steps_count) search_opts.step_index = 0;
+        std::vector<menu_item> items = {
+            {menu_values, "Value Size"_i18n, "", search_opts.size_index, {"8-bit", "16-bit", "32-bit"},
+                nullptr, &search_opts.size_index},
+            {menu_boolean, "Signed"_i18n, "", static_cast<size_t>(search_opts.is_signed ? 1 : 0), {},
+                nullptr, &search_opts.is_signed},
+            {menu_boolean, "Big Endian"_i18n, "", static_cast<size_t>(search_opts.big_endian ? 1 : 0), {},
+                nullptr, &search_opts.big_endian},
+            {menu_static, "New Search"_i18n, "", 0, {},
+                [this, finder, &menu](const menu_item &) -> bool {
+                    std::vector<::libretro::memory_region> regions;
+                    driver->get_memory_regions(regions);
+                    finder->start(regions, search_sizes[search_opts.size_index], search_opts.is_signed, search_opts.big_endian);
+                    menu.force_refresh(false);
+                    return false;
+                }
+            },
+            {menu_values, "Compare"_i18n, "", search_opts.compare,
+                {"Equal"_i18n, "Not Equal"_i18n, "Less"_i18n, "Greater"_i18n, "Less or Equal"_i18n, "Greater or Equal"_i18n},
+                nullptr, &search_opts.compare},
+            {menu_values, "Compare With"_i18n, "", search_opts.compare_with, {"Previous Value"_i18n, "Value"_i18n},
+                nullptr, &search_opts.compare_with},
+        };
+        {
+            /* left/right move value by step, all entries show current value */
+            menu_item item = {menu_values, "Value"_i18n, "", 1};
+            item.values.assign(3, std::to_string(search_opts.value));
+            item.callback = [this, &menu](const menu_item &item) -> bool {
+                auto step = value_steps[search_opts.step_index];
+                search_opts.value += item.selected == 0 ? -step : step;
+                auto &it = menu.get_items()[menu.get_selected()];
+                it.values.assign(3, std::to_string(search_opts.value));
+                it.selected = 1;
+                return false;
+            };
+            items.emplace_back(item);
+        }
+        items.push_back({menu_values, "Value Step"_i18n, "", search_opts.step_index,
+            {"1", "10", "100", "1000", "10000", "0x100", "0x10000"}, nullptr, &search_opts.step_index});
+        if (finder->active()) {
+            menu_item item = {menu_static, "Search"_i18n};
+            item.callback = [this, finder, &menu](const menu_item &) -> bool {
+                std::vector<::libretro::memory_region> regions;
+                driver->get_memory_regions(regions);
+                /* search is stopped if core memory layout changed since it started */
+                finder->filter(regions, static_cast<::libretro::cheat_search::compare_op>(search_opts.compare),
+                               search_opts.compare_with != 0, search_opts.value);
+                menu.force_refresh(false);
+                return false;
+            };
+            items.emplace_back(item);
+            items.push_back({menu_static, "Candidates"_i18n + std::string(": ") + std::to_string(finder->get_count()), "", 0, {},
+                [](const menu_item &) { return false; }});
+
+            std::vector<::libretro::cheat_search::result> results;
+            finder->get_results(results, search_results_max);
+            for (auto &r: results) {
+                /* press A to add a cheat which keeps current value */
+                items.push_back({menu_static, fmt::format("{:06X}: {} ({})", r.address, r.value, r.previous), "", 0, {},
+                    [this, finder, r, &menu](const menu_item &) -> bool {
+                        driver->get_cheats()->add_ram_cheat(fmt::format("{:06X} = {}", r.address, r.value), r.address,
+                                                            static_cast<uint32_t>(r.value), finder->get_size(), finder->get_big_endian());
+                        driver->update_cheats();
+                        /* show `Cheats` in parent menu */
+                        menu.force_refresh();
+                        return false;
+                    }});
+            }
+        }
+        menu.set_items(items);
+        int w, h;
+        driver->get_video()->get_resolution(w, h);
+        auto border = w / 16;
+        menu.set_rect(border, border, w - border * 2, h - border * 2);
+        menu.set_item_width(w - border * 2 - 90);
+    });
+    menu.event_loop();
+    return false;
+}
+
+bool ui_host::cheats_menu(menu_base *parent) {
+    auto *cheats = driver->get_cheats();
+    if (cheats->get_cheats().empty()) return false;
+    bool changed = false;
+    sdl_menu menu(driver, parent, [this, cheats, &changed](menu_base &menu) {
+        menu.set_title(std::string("[") + "Cheats"_i18n + "]");
+
+        std::vector<menu_item> items;
+        size_t index = 0;
+        for (auto &c: cheats->get_cheats()) {
+            menu_item item = {menu_boolean, c.desc.empty() ? c.code : c.desc, "", static_cast<size_t>(c.enabled ? 1 : 0)};
+            item.callback = [cheats, index, &changed](const menu_item &item) -> bool {
+                cheats->set_enabled(index, item.selected != 0);
+                changed = true;
+                return false;
+            };
+            items.emplace_back(item);
+            ++index;
+        }
+        menu.set_items(items);
+        int w, h;
+        driver->get_video()->get_resolution(w, h);
+        auto border = w / 16;
+        menu.set_rect(border, border, w - border * 2, h - border * 2);
+        menu.set_item_width(w - border * 2 - 90);
+    });
+    menu.event_loop();
+    if (changed) driver->update_cheats();
+    return false;
+}
+
 #ifdef CORE_DOWNLOADER
 std::string ui_host::download_bar(const std::string &url) {
     downloader.add("url", [](int, int64_t now, int64_t total) {
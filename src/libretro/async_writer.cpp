@@ -0,0 +1,88 @@
+#include "async_writer.h"
+
+#include "vfs_stream.h"
+
+#include "logger.h"
+
+namespace libretro {
+
+async_writer async_writer_obj;
+
+async_writer::~async_writer() {
+    std::unique_lock<std::mutex> lk(mtx);
+    if (!thread.joinable()) return;
+    done_cond.wait(lk, [this] { return order.empty() && writing.empty(); });
+    stopping = true;
+    lk.unlock();
+    cond.notify_one();
+    thread.join();
+}
+
+void async_writer::write(const std::string &path, std::vector<uint8_t> &&data) {
+    write(path, std::make_shared<const std::vector<uint8_t>>(std::move(data)));
+}
+
+void async_writer::write(const std::string &path, std::shared_ptr<const std::vector<uint8_t>> data) {
+    std::unique_lock<std::mutex> lk(mtx);
+    auto ite = pending.find(path);
+    if (ite != pending.end()) {
+        ite->second = std::move(data);
+        return;
+    }
+    pending.emplace(path, std::move(data));
+    order.push_back(path);
+    if (!thread.joinable()) thread = std::thread(&async_writer::loop, this);
+    lk.unlock();
+    cond.notify_one();
+}
+
+void async_writer::wait(const std::string &path) {
+    std::unique_lock<std::mutex> lk(mtx);
+    done_cond.wait(lk, [this, &path] { return writing != path && pending.find(path) == pending.end(); });
+}
+
+void async_writer::wait_all() {
+    std::unique_lock<std::mutex> lk(mtx);
+    done_cond.wait(lk, [this] { return order.empty() && writing.empty(); });
+}
+
+bool async_writer::write_atomic(const std::string &path, const std::vector<uint8_t> &data) {
+    std::string temp_path = path + ".tmp";
+    auto *handle = vfs_native_interface.open(temp_path.c_str(), RETRO_VFS_FILE_ACCESS_WRITE, 0);
+    if (!handle) {
+        LOG(Error, "unable to write {}", temp_path);
+        return false;
+    }
+    bool ok = data.empty() || vfs_native_interface.write(handle, data.data(), data.size()) == static_cast<int64_t>(data.size());
+    /* data must reach storage before rename, or a crash may leave an empty file in place */
+    ok = vfs_native_interface.flush(handle) == 0 && ok;
+    ok = vfs_native_interface.close(handle) == 0 && ok;
+    if (!ok || vfs_native_interface.rename(temp_path.c_str(), path.c_str()) != 0) {
+        LOG(Error, "failed to write {}", path);
+        vfs_native_interface.remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void async_writer::loop() {
+    std::unique_lock<std::mutex> lk(mtx);
+    while (true) {
+        cond.wait(lk, [this] { return stopping || !order.empty(); });
+        if (order.empty()) break;
+        writing = std::move(order.front());
+        order.pop_front();
+        auto ite = pending.find(writing);
+        auto data = std::move(ite->second);
+        pending.erase(ite);
+        lk.unlock();
+        write_atomic(writing, *data);
+        /* release buffer before waking waiters, so that a writeback stream sees it unshared */
+        data.reset();
+        lk.lock();
+        writing.clear();
+        done_cond.notify_all();
+    }
+}
+
+}
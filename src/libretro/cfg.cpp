@@ -37,7 +37,7 @@ void cfg::set_store_dir(const std::string &dir) {
         store_dir = n;
     helper::mkdir(store_dir, true);
 #else
-    util::mkdir(dir, true);
+    helper::mkdir(dir, true);
     if (realpath(dir.c_str(), n) == nullptr)
         store_dir = dir;
     else
@@ -122,10 +122,14 @@ void cfg::load(const std::string &cfgfile) {
         JREAD(resampler_quality, DEFAULT_RESAMPLER_QUALITY);
         JREAD(scaling_mode, 0);
         JREAD(scale, DEFAULT_SCALE);
+        JREAD(dirty_rects, false);
         JREAD(integer_scaling, false);
         JREAD(linear, true);
         JREAD(save_check, 0);
+        JREAD(sram_write_tracking, false);
         JREAD(language, 0);
+        JREAD(vfs_prefetch, true);
+        JREAD(vfs_stats, false);
 #undef JREAD
     }
 }
@@ -143,10 +147,14 @@ void cfg::save() {
     JWRITE(resampler_quality);
     JWRITE(scaling_mode);
     JWRITE(scale);
+    JWRITE(dirty_rects);
     JWRITE(integer_scaling);
     JWRITE(linear);
     JWRITE(save_check);
+    JWRITE(sram_write_tracking);
     JWRITE(language);
+    JWRITE(vfs_prefetch);
+    JWRITE(vfs_stats);
 #undef JWRITE
     try {
         auto content = j.dump(4);
@@ -0,0 +1,233 @@
+#include "cheat_engine.h"
+
+#include "memory_map.h"
+#include "async_writer.h"
+#include "helper.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace libretro {
+
+enum :uint32_t {
+    /* handler of cheats written to RAM by frontend */
+    CHEAT_HANDLER_RETRO = 1,
+    /* cheat type which sets RAM to value, other types are not supported */
+    CHEAT_TYPE_SET_TO_VALUE = 1,
+    /* memory_search_size of 8/16/32-bit values, smaller ones address bits */
+    CHEAT_SEARCH_SIZE_8BIT = 3,
+    CHEAT_SEARCH_SIZE_32BIT = 5,
+    /* repeated writes of a single cheat, a larger count in file is clamped */
+    CHEAT_MAX_REPEAT_COUNT = 0x10000,
+};
+
+static inline std::string trim(const std::string &s) {
+    auto first = s.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return std::string();
+    auto last = s.find_last_not_of(" \t\r");
+    return s.substr(first, last - first + 1);
+}
+
+/* parse `key = value` lines, quotes around values are removed */
+static void parse_config(const std::string &text, std::map<std::string, std::string> &values) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        auto end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        auto line = trim(text.substr(pos, end - pos));
+        pos = end + 1;
+        if (line.empty() || line[0] == '#') continue;
+        auto eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        auto value = trim(line.substr(eq + 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        values[trim(line.substr(0, eq))] = value;
+    }
+}
+
+static uint64_t field_number(const std::map<std::string, std::string> &fields, const char *key, uint64_t def) {
+    auto ite = fields.find(key);
+    if (ite == fields.end() || ite->second.empty()) return def;
+    const auto &s = ite->second;
+    bool hex = s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X');
+    return std::strtoull(s.c_str(), nullptr, hex ? 16 : 10);
+}
+
+static bool field_bool(const std::map<std::string, std::string> &fields, const char *key) {
+    auto ite = fields.find(key);
+    return ite != fields.end() && (ite->second == "true" || ite->second == "1");
+}
+
+bool cheat_engine::load(const std::string &filename) {
+    clear();
+    path = filename;
+    /* wait for file written by previous game session */
+    async_writer_obj.wait(filename);
+    std::string text;
+    if (!helper::read_file(filename, text)) return false;
+    std::map<std::string, std::string> values;
+    parse_config(text, values);
+
+    auto count = field_number(values, "cheats", 0);
+    for (uint64_t i = 0; i < count; ++i) {
+        cheat c = {};
+        auto prefix = "cheat" + std::to_string(i) + "_";
+        for (auto ite = values.lower_bound(prefix); ite != values.end() && ite->first.compare(0, prefix.size(), prefix) == 0; ++ite) {
+            c.fields[ite->first.substr(prefix.size())] = ite->second;
+        }
+        auto ite = c.fields.find("desc");
+        if (ite != c.fields.end()) c.desc = ite->second;
+        ite = c.fields.find("code");
+        if (ite != c.fields.end()) c.code = ite->second;
+        c.enabled = field_bool(c.fields, "enable");
+        c.ram = field_number(c.fields, "handler", 0) == CHEAT_HANDLER_RETRO;
+        c.address = static_cast<size_t>(field_number(c.fields, "address", 0));
+        c.value = static_cast<uint32_t>(field_number(c.fields, "value", 0));
+        c.big_endian = field_bool(c.fields, "big_endian");
+        c.repeat_count = static_cast<uint32_t>(std::min<uint64_t>(field_number(c.fields, "repeat_count", 1), CHEAT_MAX_REPEAT_COUNT));
+        c.repeat_add_to_value = static_cast<uint32_t>(field_number(c.fields, "repeat_add_to_value", 0));
+        c.repeat_add_to_address = static_cast<uint32_t>(field_number(c.fields, "repeat_add_to_address", 1));
+        auto search_size = field_number(c.fields, "memory_search_size", CHEAT_SEARCH_SIZE_8BIT);
+        auto type = field_number(c.fields, "cheat_type", CHEAT_TYPE_SET_TO_VALUE);
+        if (search_size >= CHEAT_SEARCH_SIZE_8BIT && search_size <= CHEAT_SEARCH_SIZE_32BIT && type == CHEAT_TYPE_SET_TO_VALUE) {
+            c.size = 1U << (search_size - CHEAT_SEARCH_SIZE_8BIT);
+        } else if (c.ram) {
+            /* kept in list and file, but never written */
+            LOG(WARN, "cheat {}: only 8/16/32-bit values set to constant are supported", i);
+        }
+        cheats.emplace_back(std::move(c));
+    }
+    dirty = true;
+    return !cheats.empty();
+}
+
+void cheat_engine::save(const std::string &filename) {
+    if (!filename.empty()) path = filename;
+    if (path.empty()) return;
+    std::string text = "cheats = \"" + std::to_string(cheats.size()) + "\"\n\n";
+    for (size_t i = 0; i < cheats.size(); ++i) {
+        auto &c = cheats[i];
+        c.fields["enable"] = c.enabled ? "true" : "false";
+        auto prefix = "cheat" + std::to_string(i) + "_";
+        for (auto &f: c.fields) {
+            text += prefix + f.first + " = \"" + f.second + "\"\n";
+        }
+        text += '\n';
+    }
+    async_writer_obj.write(path, std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+void cheat_engine::clear() {
+    path.clear();
+    cheats.clear();
+    writes64.clear();
+    writes32.clear();
+    writes16.clear();
+    writes8.clear();
+    dirty = false;
+}
+
+void cheat_engine::set_enabled(size_t index, bool enabled) {
+    if (index >= cheats.size()) return;
+    cheats[index].enabled = enabled;
+    dirty = true;
+}
+
+void cheat_engine::add_ram_cheat(const std::string &desc, size_t address, uint32_t value, uint32_t size, bool big_endian) {
+    uint32_t search_size = CHEAT_SEARCH_SIZE_8BIT;
+    while ((1U << (search_size - CHEAT_SEARCH_SIZE_8BIT)) < size && search_size < CHEAT_SEARCH_SIZE_32BIT) ++search_size;
+    cheat c = {desc, std::string(), true, true, address, value, 1U << (search_size - CHEAT_SEARCH_SIZE_8BIT), big_endian, 1, 0, 1, {}};
+    c.fields = {
+        {"desc", desc},
+        {"code", ""},
+        {"handler", std::to_string(CHEAT_HANDLER_RETRO)},
+        {"address", std::to_string(address)},
+        {"value", std::to_string(value)},
+        {"memory_search_size", std::to_string(search_size)},
+        {"big_endian", big_endian ? "true" : "false"},
+        {"cheat_type", std::to_string(CHEAT_TYPE_SET_TO_VALUE)},
+        {"repeat_count", "1"},
+        {"repeat_add_to_value", "0"},
+        {"repeat_add_to_address", "1"},
+    };
+    cheats.emplace_back(std::move(c));
+    dirty = true;
+}
+
+void cheat_engine::apply_codes(void (*cheat_reset)(), void (*cheat_set)(unsigned, bool, const char*)) const {
+    cheat_reset();
+    unsigned index = 0;
+    for (const auto &c: cheats) {
+        if (c.ram || c.code.empty()) continue;
+        cheat_set(index++, c.enabled, c.code.c_str());
+    }
+}
+
+void cheat_engine::compile(const std::vector<memory_region> &regions) {
+    dirty = false;
+    writes64.clear();
+    writes32.clear();
+    writes16.clear();
+    writes8.clear();
+
+    std::vector<std::pair<uint8_t*, uint8_t>> pokes;
+    for (const auto &c: cheats) {
+        if (!c.enabled || !c.ram || !c.size) continue;
+        size_t address = c.address;
+        uint32_t value = c.value;
+        for (uint32_t r = 0; r < std::max(c.repeat_count, 1U); ++r) {
+            /* bytes are translated one by one, as a value may cross page or descriptor boundary */
+            for (uint32_t i = 0; i < c.size; ++i) {
+                size_t addr = address + i;
+                auto ite = std::upper_bound(regions.begin(), regions.end(), addr, [](size_t a, const memory_region &r) {
+                    return a < r.address;
+                });
+                if (ite == regions.begin()) continue;
+                --ite;
+                if (addr - ite->address >= ite->size) continue;
+                pokes.emplace_back(ite->ptr + (addr - ite->address), static_cast<uint8_t>(value >> (8 * (c.big_endian ? c.size - 1 - i : i))));
+            }
+            address += static_cast<size_t>(c.repeat_add_to_address) * c.size;
+            value += c.repeat_add_to_value;
+        }
+    }
+
+    /* sort by host address, later cheats win on same byte, adjacent bytes are merged into runs */
+    std::stable_sort(pokes.begin(), pokes.end(), [](const std::pair<uint8_t*, uint8_t> &a, const std::pair<uint8_t*, uint8_t> &b) {
+        return a.first < b.first;
+    });
+    std::vector<uint8_t> run;
+    for (size_t i = 0; i < pokes.size(); ++i) {
+        if (i + 1 < pokes.size() && pokes[i + 1].first == pokes[i].first) continue;
+        run.push_back(pokes[i].second);
+        /* continue run if next byte follows this one */
+        size_t next = i + 1;
+        while (next < pokes.size() && pokes[next].first == pokes[i].first) ++next;
+        if (next < pokes.size() && pokes[next].first == pokes[i].first + 1) continue;
+        auto *dst = pokes[i].first + 1 - run.size();
+        size_t pos = 0;
+        while (pos < run.size()) {
+            auto left = run.size() - pos;
+            if (left >= 8) {
+                add_write(writes64, dst + pos, run.data() + pos);
+                pos += 8;
+            } else if (left >= 4) {
+                add_write(writes32, dst + pos, run.data() + pos);
+                pos += 4;
+            } else if (left >= 2) {
+                add_write(writes16, dst + pos, run.data() + pos);
+                pos += 2;
+            } else {
+                add_write(writes8, dst + pos, run.data() + pos);
+                pos += 1;
+            }
+        }
+        run.clear();
+    }
+}
+
+}
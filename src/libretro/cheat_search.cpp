@@ -0,0 +1,422 @@
+#include "cheat_search.h"
+
+#include <bitset>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CHEAT_SEARCH_USE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CHEAT_SEARCH_USE_NEON
+#elif defined(__mips_msa)
+#include <msa.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_MIPS_MSA
+#define HWCAP_MIPS_MSA (1u << 1u)
+#endif
+#define CHEAT_SEARCH_USE_MSA
+#endif
+#if defined(CHEAT_SEARCH_USE_SSE2) || defined(CHEAT_SEARCH_USE_NEON) || defined(CHEAT_SEARCH_USE_MSA)
+#define CHEAT_SEARCH_USE_SIMD
+#endif
+
+namespace libretro {
+
+enum :uint32_t {
+    /* elements per bitmap word */
+    SEARCH_WORD_ELEMENTS = 64,
+};
+
+/* every compare_op is reduced to `equal` or `greater` with optionally swapped operands and inverted result */
+struct search_query {
+    bool use_equal;
+    bool swap;
+    bool invert;
+    bool is_signed;
+    bool big_endian;
+    bool with_value;
+    int64_t value;
+};
+
+static search_query make_query(cheat_search::compare_op op) {
+    switch (op) {
+    case cheat_search::cmp_not_equal: return {true, false, true, false, false, false, 0};
+    case cheat_search::cmp_less: return {false, true, false, false, false, false, 0};
+    case cheat_search::cmp_greater: return {false, false, false, false, false, false, 0};
+    /* a <= b is !(a > b), a >= b is !(b > a) */
+    case cheat_search::cmp_less_equal: return {false, false, true, false, false, false, 0};
+    case cheat_search::cmp_greater_equal: return {false, true, true, false, false, false, 0};
+    default: return {true, false, false, false, false, false, 0};
+    }
+}
+
+static inline int64_t truncate_value(int64_t value, uint32_t size, bool is_signed) {
+    uint32_t shift = 64 - size * 8;
+    uint64_t v = static_cast<uint64_t>(value) << shift;
+    return is_signed ? static_cast<int64_t>(v) >> shift : static_cast<int64_t>(v >> shift);
+}
+
+template <uint32_t SIZE>
+static inline int64_t load_value(const uint8_t *p, bool is_signed, bool big_endian) {
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < SIZE; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * (big_endian ? SIZE - 1 - i : i));
+    }
+    if (!is_signed) return v;
+    const uint32_t shift = 32 - SIZE * 8;
+    return static_cast<int32_t>(v << shift) >> shift;
+}
+
+/* value mapped to unsigned key, so that keys compare like values */
+template <uint32_t SIZE, bool BE_ORDER>
+static inline uint32_t load_key(const uint8_t *p, uint32_t bias) {
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < SIZE; ++i) {
+        v |= static_cast<uint32_t>(p[i]) << (8 * (BE_ORDER ? SIZE - 1 - i : i));
+    }
+    return v ^ bias;
+}
+
+/* match mask of `n` elements, bit i is set if element i matches,
+ * branch-free in loop body as compilers do not unswitch loops at -O2 */
+template <uint32_t SIZE, bool BE_ORDER>
+static uint64_t match_scalar(const uint8_t *mem, const uint8_t *snapshot, size_t n, const search_query &q) {
+    const uint32_t bias = q.is_signed ? 1U << (SIZE * 8 - 1) : 0;
+    const uint32_t value_key = (static_cast<uint32_t>(q.value) & (0xFFFFFFFFU >> (32 - SIZE * 8))) ^ bias;
+    const uint32_t sel_eq = q.use_equal, sel_gt = !q.use_equal && !q.swap, sel_lt = !q.use_equal && q.swap;
+    const uint32_t from_snapshot = q.with_value ? 0 : 0xFFFFFFFFU;
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t a = load_key<SIZE, BE_ORDER>(mem + i * SIZE, bias);
+        uint32_t b = (load_key<SIZE, BE_ORDER>(snapshot + i * SIZE, bias) & from_snapshot) | (value_key & ~from_snapshot);
+        uint32_t matched = ((a == b) & sel_eq) | ((a > b) & sel_gt) | ((a < b) & sel_lt);
+        mask |= static_cast<uint64_t>(matched) << i;
+    }
+    return q.invert ? ~mask : mask;
+}
+
+template <uint32_t SIZE>
+static inline uint64_t match_scalar(const uint8_t *mem, const uint8_t *snapshot, size_t n, const search_query &q) {
+    return q.big_endian ? match_scalar<SIZE, true>(mem, snapshot, n, q) : match_scalar<SIZE, false>(mem, snapshot, n, q);
+}
+
+/* each SIMD path provides these on 128-bit vectors:
+ * prepare() fixes up byte order and biases unsigned values by sign bit, so that signed compares order them,
+ * compare() sets all bits of elements which are equal or greater,
+ * element_mask() packs one bit per element from compare result */
+#ifdef CHEAT_SEARCH_USE_SSE2
+using simd_vec = __m128i;
+
+static inline bool simd_available() { return true; }
+
+static inline simd_vec load_vec(const uint8_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+template <uint32_t SIZE>
+static inline simd_vec prepare(simd_vec x, bool big_endian, simd_vec bias) {
+    if constexpr (SIZE >= 2) {
+        if (big_endian) {
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+            if constexpr (SIZE == 4) {
+                x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            }
+        }
+    }
+    return _mm_xor_si128(x, bias);
+}
+
+template <uint32_t SIZE>
+static inline simd_vec set_value(uint32_t v) {
+    if constexpr (SIZE == 1) return _mm_set1_epi8(static_cast<char>(v));
+    else if constexpr (SIZE == 2) return _mm_set1_epi16(static_cast<short>(v));
+    else return _mm_set1_epi32(static_cast<int>(v));
+}
+
+template <uint32_t SIZE>
+static inline simd_vec compare(simd_vec a, simd_vec b, bool use_equal) {
+    if constexpr (SIZE == 1) return use_equal ? _mm_cmpeq_epi8(a, b) : _mm_cmpgt_epi8(a, b);
+    else if constexpr (SIZE == 2) return use_equal ? _mm_cmpeq_epi16(a, b) : _mm_cmpgt_epi16(a, b);
+    else return use_equal ? _mm_cmpeq_epi32(a, b) : _mm_cmpgt_epi32(a, b);
+}
+
+template <uint32_t SIZE>
+static inline uint32_t element_mask(simd_vec r) {
+    if constexpr (SIZE == 1) return static_cast<uint32_t>(_mm_movemask_epi8(r));
+    else if constexpr (SIZE == 2) return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(r, _mm_setzero_si128())));
+    else return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(r)));
+}
+#endif
+
+#ifdef CHEAT_SEARCH_USE_NEON
+using simd_vec = uint8x16_t;
+
+static inline bool simd_available() { return true; }
+
+static inline simd_vec load_vec(const uint8_t *p) {
+    return vld1q_u8(p);
+}
+
+template <uint32_t SIZE>
+static inline simd_vec prepare(simd_vec x, bool big_endian, simd_vec bias) {
+    if constexpr (SIZE == 2) {
+        if (big_endian) x = vrev16q_u8(x);
+    } else if constexpr (SIZE == 4) {
+        if (big_endian) x = vrev32q_u8(x);
+    }
+    return veorq_u8(x, bias);
+}
+
+template <uint32_t SIZE>
+static inline simd_vec set_value(uint32_t v) {
+    if constexpr (SIZE == 1) return vdupq_n_u8(static_cast<uint8_t>(v));
+    else if constexpr (SIZE == 2) return vreinterpretq_u8_u16(vdupq_n_u16(static_cast<uint16_t>(v)));
+    else return vreinterpretq_u8_u32(vdupq_n_u32(v));
+}
+
+template <uint32_t SIZE>
+static inline simd_vec compare(simd_vec a, simd_vec b, bool use_equal) {
+    if constexpr (SIZE == 1) {
+        return use_equal ? vceqq_u8(a, b) : vcgtq_s8(vreinterpretq_s8_u8(a), vreinterpretq_s8_u8(b));
+    } else if constexpr (SIZE == 2) {
+        return vreinterpretq_u8_u16(use_equal ? vceqq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b))
+            : vcgtq_s16(vreinterpretq_s16_u8(a), vreinterpretq_s16_u8(b)));
+    } else {
+        return vreinterpretq_u8_u32(use_equal ? vceqq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b))
+            : vcgtq_s32(vreinterpretq_s32_u8(a), vreinterpretq_s32_u8(b)));
+    }
+}
+
+/* bit i is set if byte i is 0xFF, no movemask on NEON so weighted bytes are added pairwise,
+ * vaddv is avoided as it is AArch64 only */
+static inline uint32_t byte_mask(uint8x8_t r) {
+    static const uint8_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    return static_cast<uint32_t>(vget_lane_u64(vpaddl_u32(vpaddl_u16(vpaddl_u8(vand_u8(r, vld1_u8(weights))))), 0));
+}
+
+template <uint32_t SIZE>
+static inline uint32_t element_mask(simd_vec r) {
+    if constexpr (SIZE == 1) {
+        return byte_mask(vget_low_u8(r)) | (byte_mask(vget_high_u8(r)) << 8);
+    } else if constexpr (SIZE == 2) {
+        return byte_mask(vmovn_u16(vreinterpretq_u16_u8(r)));
+    } else {
+        uint16x4_t n = vmovn_u32(vreinterpretq_u32_u8(r));
+        return byte_mask(vmovn_u16(vcombine_u16(n, n))) & 0xFU;
+    }
+}
+#endif
+
+#ifdef CHEAT_SEARCH_USE_MSA
+using simd_vec = v16i8;
+
+/* binary built with -mmsa may still run on cores without it */
+static inline bool simd_available() {
+    static const bool available = (getauxval(AT_HWCAP) & HWCAP_MIPS_MSA) != 0;
+    return available;
+}
+
+static inline simd_vec load_vec(const uint8_t *p) {
+    return __msa_ld_b(const_cast<uint8_t*>(p), 0);
+}
+
+template <uint32_t SIZE>
+static inline simd_vec prepare(simd_vec x, bool big_endian, simd_vec bias) {
+    /* shf.b shuffles bytes within each group of 4 */
+    if constexpr (SIZE == 2) {
+        if (big_endian) x = __msa_shf_b(x, 0xB1);
+    } else if constexpr (SIZE == 4) {
+        if (big_endian) x = __msa_shf_b(x, 0x1B);
+    }
+    return (v16i8)__msa_xor_v((v16u8)x, (v16u8)bias);
+}
+
+template <uint32_t SIZE>
+static inline simd_vec set_value(uint32_t v) {
+    if constexpr (SIZE == 1) return __msa_fill_b(static_cast<int>(v));
+    else if constexpr (SIZE == 2) return (v16i8)__msa_fill_h(static_cast<int>(v));
+    else return (v16i8)__msa_fill_w(static_cast<int>(v));
+}
+
+/* MSA only has less-than, so a > b is b < a */
+template <uint32_t SIZE>
+static inline simd_vec compare(simd_vec a, simd_vec b, bool use_equal) {
+    if constexpr (SIZE == 1) {
+        return use_equal ? __msa_ceq_b(a, b) : __msa_clt_s_b(b, a);
+    } else if constexpr (SIZE == 2) {
+        return (v16i8)(use_equal ? __msa_ceq_h((v8i16)a, (v8i16)b) : __msa_clt_s_h((v8i16)b, (v8i16)a));
+    } else {
+        return (v16i8)(use_equal ? __msa_ceq_w((v4i32)a, (v4i32)b) : __msa_clt_s_w((v4i32)b, (v4i32)a));
+    }
+}
+
+/* no movemask on MSA, weighted elements are added up into the two doublewords,
+ * copy_s_w is used as copy_u_w is not available on MIPS32 */
+template <uint32_t SIZE>
+static inline uint32_t element_mask(simd_vec r) {
+    v2u64 d;
+    if constexpr (SIZE == 1) {
+        const v16u8 weights = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+        v16u8 m = __msa_and_v((v16u8)r, weights);
+        v8u16 h = __msa_hadd_u_h(m, m);
+        v4u32 w = __msa_hadd_u_w(h, h);
+        d = __msa_hadd_u_d(w, w);
+        return static_cast<uint32_t>(__msa_copy_s_w((v4i32)d, 0)) | (static_cast<uint32_t>(__msa_copy_s_w((v4i32)d, 2)) << 8);
+    } else if constexpr (SIZE == 2) {
+        const v8u16 weights = {1, 2, 4, 8, 16, 32, 64, 128};
+        v8u16 m = (v8u16)__msa_and_v((v16u8)r, (v16u8)weights);
+        v4u32 w = __msa_hadd_u_w(m, m);
+        d = __msa_hadd_u_d(w, w);
+    } else {
+        const v4u32 weights = {1, 2, 4, 8};
+        v4u32 m = (v4u32)__msa_and_v((v16u8)r, (v16u8)weights);
+        d = __msa_hadd_u_d(m, m);
+    }
+    return static_cast<uint32_t>(__msa_copy_s_w((v4i32)d, 0)) | static_cast<uint32_t>(__msa_copy_s_w((v4i32)d, 2));
+}
+#endif
+
+#ifdef CHEAT_SEARCH_USE_SIMD
+/* match mask of a full word of SEARCH_WORD_ELEMENTS elements */
+template <uint32_t SIZE>
+static uint64_t match_simd(const uint8_t *mem, const uint8_t *snapshot, const search_query &q, simd_vec bias, simd_vec value) {
+    enum :uint32_t { LANES = 16 / SIZE };
+    uint64_t mask = 0;
+    for (uint32_t v = 0; v < SEARCH_WORD_ELEMENTS / LANES; ++v) {
+        simd_vec a = prepare<SIZE>(load_vec(mem + v * 16), q.big_endian, bias);
+        simd_vec b = q.with_value ? value : prepare<SIZE>(load_vec(snapshot + v * 16), q.big_endian, bias);
+        simd_vec r = q.swap ? compare<SIZE>(b, a, q.use_equal) : compare<SIZE>(a, b, q.use_equal);
+        mask |= static_cast<uint64_t>(element_mask<SIZE>(r)) << (v * LANES);
+    }
+    return q.invert ? ~mask : mask;
+}
+#endif
+
+/* filter candidates of one region and update snapshot of remaining ones, return count of remaining candidates */
+template <uint32_t SIZE>
+static size_t filter_values(const uint8_t *mem, uint8_t *snapshot, uint64_t *bits, size_t elements, const search_query &q) {
+    size_t words = (elements + SEARCH_WORD_ELEMENTS - 1) / SEARCH_WORD_ELEMENTS;
+    size_t full_words = elements / SEARCH_WORD_ELEMENTS;
+#ifdef CHEAT_SEARCH_USE_SIMD
+    const uint32_t sign = 1U << (SIZE * 8 - 1);
+    const simd_vec bias = set_value<SIZE>(q.is_signed ? 0 : sign);
+    const simd_vec value = set_value<SIZE>(static_cast<uint32_t>(q.value) ^ (q.is_signed ? 0 : sign));
+    if (!simd_available()) full_words = 0;
+#endif
+    size_t count = 0;
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t b = bits[w];
+        /* most words are empty after first few searches */
+        if (!b) continue;
+        size_t offset = w * SEARCH_WORD_ELEMENTS * SIZE;
+        size_t n = std::min<size_t>(SEARCH_WORD_ELEMENTS, elements - w * SEARCH_WORD_ELEMENTS);
+#ifdef CHEAT_SEARCH_USE_SIMD
+        if (w < full_words) {
+            b &= match_simd<SIZE>(mem + offset, snapshot + offset, q, bias, value);
+        } else {
+            b &= match_scalar<SIZE>(mem + offset, snapshot + offset, n, q);
+        }
+#else
+        (void)full_words;
+        b &= match_scalar<SIZE>(mem + offset, snapshot + offset, n, q);
+#endif
+        bits[w] = b;
+        if (!b) continue;
+        memcpy(snapshot + offset, mem + offset, n * SIZE);
+        count += std::bitset<64>(b).count();
+    }
+    return count;
+}
+
+void cheat_search::start(const std::vector<memory_region> &regions, value_size sz, bool sign, bool be) {
+    clear();
+    size = sz;
+    is_signed = sign;
+    big_endian = be;
+    for (const auto &r: regions) {
+        size_t elements = r.size / size;
+        if (!r.ptr || !elements) continue;
+        blocks.emplace_back();
+        auto &b = blocks.back();
+        b.region = r;
+        b.elements = elements;
+        b.snapshot.assign(r.ptr, r.ptr + elements * size);
+        b.bits.assign((elements + SEARCH_WORD_ELEMENTS - 1) / SEARCH_WORD_ELEMENTS, ~0ULL);
+        if (elements % SEARCH_WORD_ELEMENTS) {
+            b.bits.back() = (1ULL << (elements % SEARCH_WORD_ELEMENTS)) - 1ULL;
+        }
+        count += elements;
+    }
+}
+
+void cheat_search::clear() {
+    blocks.clear();
+    count = 0;
+}
+
+bool cheat_search::filter(const std::vector<memory_region> &regions, compare_op op, bool with_value, int64_t value) {
+    if (!active()) return false;
+    /* regions are refetched each time, as cores may move memory between searches */
+    size_t index = 0;
+    for (const auto &r: regions) {
+        if (!r.ptr || r.size < size) continue;
+        if (index >= blocks.size() || blocks[index].region.address != r.address || blocks[index].region.size != r.size) {
+            clear();
+            return false;
+        }
+        blocks[index++].region.ptr = r.ptr;
+    }
+    if (index != blocks.size()) {
+        clear();
+        return false;
+    }
+
+    auto q = make_query(op);
+    q.is_signed = is_signed;
+    q.big_endian = big_endian;
+    q.with_value = with_value;
+    q.value = truncate_value(value, size, is_signed);
+    count = 0;
+    for (auto &b: blocks) {
+        switch (size) {
+        case size_8:
+            count += filter_values<1>(b.region.ptr, b.snapshot.data(), b.bits.data(), b.elements, q);
+            break;
+        case size_16:
+            count += filter_values<2>(b.region.ptr, b.snapshot.data(), b.bits.data(), b.elements, q);
+            break;
+        default:
+            count += filter_values<4>(b.region.ptr, b.snapshot.data(), b.bits.data(), b.elements, q);
+            break;
+        }
+    }
+    return true;
+}
+
+void cheat_search::get_results(std::vector<result> &results, size_t max) const {
+    results.clear();
+    for (const auto &b: blocks) {
+        for (size_t w = 0; w < b.bits.size(); ++w) {
+            uint64_t bits = b.bits[w];
+            for (size_t i = w * SEARCH_WORD_ELEMENTS; bits; ++i, bits >>= 1) {
+                if (!(bits & 1)) continue;
+                if (results.size() >= max) return;
+                results.push_back({b.region.address + i * size, read_value(b.region.ptr + i * size),
+                                   read_value(b.snapshot.data() + i * size)});
+            }
+        }
+    }
+}
+
+int64_t cheat_search::read_value(const uint8_t *p) const {
+    switch (size) {
+    case size_8: return load_value<1>(p, is_signed, big_endian);
+    case size_16: return load_value<2>(p, is_signed, big_endian);
+    default: return load_value<4>(p, is_signed, big_endian);
+    }
+}
+
+}
@@ -0,0 +1,384 @@
+#include "chunked_image.h"
+
+#include "vfs_stream.h"
+
+#include "helper.h"
+#include "logger.h"
+
+#include <miniz.h>
+
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+namespace libretro {
+
+enum :uint32_t {
+    CHUNKED_IMAGE_HEADER_SIZE = 24,
+    /* reject larger chunks, so that a broken header does not cause huge allocations */
+    CHUNKED_IMAGE_MAX_CHUNK_SIZE = 16U * 1024U * 1024U,
+    /* number of decompressed chunks kept in cache */
+    CHUNK_CACHE_SIZE = 32,
+    /* number of chunks decompressed ahead of sequential reads */
+    CHUNK_READ_AHEAD = 4,
+    /* max number of read-ahead decompression threads */
+    CHUNK_MAX_WORKERS = 2,
+    /* chunks compressed by each thread in one batch while creating image */
+    CHUNK_CREATE_BATCH = 8,
+};
+
+static const char chunked_image_magic[4] = {'S', 'R', 'Z', '1'};
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static inline void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 4; i-- > 0;) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 8; i-- > 0;) v = (v << 8) | p[i];
+    return v;
+}
+
+/* native VFS may return short reads, loop until `len` bytes are read */
+static bool read_full(retro_vfs_file_handle *file, void *buf, uint64_t len) {
+    auto *ptr = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        auto n = vfs_native_interface.read(file, ptr, len);
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool write_full(retro_vfs_file_handle *file, const void *buf, uint64_t len) {
+    return vfs_native_interface.write(file, buf, len) == static_cast<int64_t>(len);
+}
+
+class chunked_image_stream: public vfs_stream {
+public:
+    ~chunked_image_stream() override;
+
+    bool open(const std::string &path);
+
+    uint64_t size() const override { return raw_size; }
+    int64_t read(void *buf, uint64_t len) override;
+
+private:
+    struct chunk {
+        uint32_t index;
+        std::vector<uint8_t> data;
+        /* set by decompressing thread, not-ready chunks are never evicted */
+        bool ready = false;
+        bool failed = false;
+    };
+    struct job {
+        chunk *target;
+        std::vector<uint8_t> comp;
+    };
+
+    inline uint32_t chunk_length(uint32_t index) const {
+        return static_cast<uint32_t>(std::min<uint64_t>(chunk_size, raw_size - uint64_t(index) * chunk_size));
+    }
+    bool read_compressed(uint32_t index, std::vector<uint8_t> &comp);
+    bool decompress(uint32_t index, const std::vector<uint8_t> &comp, std::vector<uint8_t> &out) const;
+    /* get chunk from cache, wait for it if being decompressed, or decompress it now */
+    const chunk *fetch(uint32_t index);
+    /* insert a chunk at front of cache, evicting least recently used ready chunks, must hold `mtx` */
+    chunk *insert(uint32_t index);
+    /* queue chunks following `index` for decompression on worker threads */
+    void read_ahead(uint32_t index);
+    void worker_loop();
+
+    /* file handle is only touched by thread reading the stream */
+    retro_vfs_file_handle *file = nullptr;
+    uint32_t chunk_size = 0;
+    uint32_t chunk_count = 0;
+    uint64_t raw_size = 0;
+    std::vector<uint64_t> offsets;
+    uint32_t last_index = UINT32_MAX;
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    /* most recently used first */
+    std::list<chunk> cache;
+    std::unordered_map<uint32_t, std::list<chunk>::iterator> cache_map;
+    std::deque<job> jobs;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+chunked_image_stream::~chunked_image_stream() {
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        stopping = true;
+        jobs.clear();
+    }
+    cond.notify_all();
+    for (auto &th: workers) th.join();
+    if (file) vfs_native_interface.close(file);
+}
+
+bool chunked_image_stream::open(const std::string &path) {
+    file = vfs_native_interface.open(path.c_str(), RETRO_VFS_FILE_ACCESS_READ, 0);
+    if (!file) return false;
+    auto file_size = vfs_native_interface.size(file);
+    uint8_t header[CHUNKED_IMAGE_HEADER_SIZE];
+    if (file_size < CHUNKED_IMAGE_HEADER_SIZE || !read_full(file, header, CHUNKED_IMAGE_HEADER_SIZE)
+        || memcmp(header, chunked_image_magic, 4) != 0) {
+        LOG(Error, "{} is not a chunked image", path);
+        return false;
+    }
+    chunk_size = get_u32(header + 4);
+    raw_size = get_u64(header + 8);
+    chunk_count = get_u32(header + 16);
+    uint64_t table_end = CHUNKED_IMAGE_HEADER_SIZE + (uint64_t(chunk_count) + 1) * 8;
+    if (chunk_size == 0 || chunk_size > CHUNKED_IMAGE_MAX_CHUNK_SIZE
+        || uint64_t(chunk_count) != (raw_size + chunk_size - 1) / chunk_size
+        || table_end > static_cast<uint64_t>(file_size)) {
+        LOG(Error, "bad header in chunked image {}", path);
+        return false;
+    }
+    std::vector<uint8_t> table(static_cast<size_t>(table_end - CHUNKED_IMAGE_HEADER_SIZE));
+    if (!read_full(file, table.data(), table.size())) return false;
+    offsets.resize(chunk_count + 1);
+    for (uint32_t i = 0; i <= chunk_count; ++i) {
+        offsets[i] = get_u64(&table[i * 8]);
+        bool bad = i == 0 ? offsets[0] < table_end
+                          : offsets[i] < offsets[i - 1] || offsets[i] - offsets[i - 1] > chunk_length(i - 1);
+        if (bad || offsets[i] > static_cast<uint64_t>(file_size)) {
+            LOG(Error, "bad chunk index in chunked image {}", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+int64_t chunked_image_stream::read(void *buf, uint64_t len) {
+    if (pos >= raw_size) return 0;
+    len = std::min(len, raw_size - pos);
+    auto *out = static_cast<uint8_t*>(buf);
+    uint64_t total = 0;
+    while (total < len) {
+        auto index = static_cast<uint32_t>(pos / chunk_size);
+        if (index != last_index) {
+            if (index == last_index + 1) read_ahead(index);
+            last_index = index;
+        }
+        const auto *c = fetch(index);
+        if (!c) break;
+        auto offset = static_cast<size_t>(pos - uint64_t(index) * chunk_size);
+        auto avail = std::min<uint64_t>(c->data.size() - offset, len - total);
+        memcpy(out, c->data.data() + offset, static_cast<size_t>(avail));
+        out += avail;
+        total += avail;
+        pos += avail;
+    }
+    return total ? static_cast<int64_t>(total) : -1;
+}
+
+bool chunked_image_stream::read_compressed(uint32_t index, std::vector<uint8_t> &comp) {
+    comp.resize(static_cast<size_t>(offsets[index + 1] - offsets[index]));
+    if (vfs_native_interface.seek(file, static_cast<int64_t>(offsets[index]), RETRO_VFS_SEEK_POSITION_START) < 0)
+        return false;
+    return read_full(file, comp.data(), comp.size());
+}
+
+bool chunked_image_stream::decompress(uint32_t index, const std::vector<uint8_t> &comp, std::vector<uint8_t> &out) const {
+    auto len = chunk_length(index);
+    if (comp.size() == len) {
+        /* stored as raw data */
+        out = comp;
+        return true;
+    }
+    out.resize(len);
+    mz_ulong out_len = len;
+    return mz_uncompress(out.data(), &out_len, comp.data(), static_cast<mz_ulong>(comp.size())) == MZ_OK
+        && out_len == len;
+}
+
+const chunked_image_stream::chunk *chunked_image_stream::fetch(uint32_t index) {
+    std::unique_lock<std::mutex> lk(mtx);
+    auto ite = cache_map.find(index);
+    if (ite != cache_map.end()) {
+        cache.splice(cache.begin(), cache, ite->second);
+        auto &c = *ite->second;
+        cond.wait(lk, [&c] { return c.ready; });
+        if (!c.failed) return &c;
+        cache.erase(ite->second);
+        cache_map.erase(ite);
+        return nullptr;
+    }
+    lk.unlock();
+    std::vector<uint8_t> comp, data;
+    if (!read_compressed(index, comp) || !decompress(index, comp, data)) {
+        LOG(Error, "failed to decompress chunk {} of chunked image", index);
+        return nullptr;
+    }
+    lk.lock();
+    auto *c = insert(index);
+    c->data = std::move(data);
+    c->ready = true;
+    return c;
+}
+
+chunked_image_stream::chunk *chunked_image_stream::insert(uint32_t index) {
+    auto ite = cache.end();
+    while (cache.size() >= CHUNK_CACHE_SIZE && ite != cache.begin()) {
+        --ite;
+        if (!ite->ready) continue;
+        cache_map.erase(ite->index);
+        ite = cache.erase(ite);
+    }
+    cache.emplace_front();
+    auto &c = cache.front();
+    c.index = index;
+    cache_map[index] = cache.begin();
+    return &c;
+}
+
+void chunked_image_stream::read_ahead(uint32_t index) {
+    if (workers.empty()) {
+        unsigned hw = std::thread::hardware_concurrency();
+        /* no point decompressing ahead on a single core */
+        if (hw < 2) return;
+        unsigned count = std::min<unsigned>(hw - 1, CHUNK_MAX_WORKERS);
+        for (unsigned i = 0; i < count; ++i) {
+            workers.emplace_back(&chunked_image_stream::worker_loop, this);
+        }
+    }
+    auto end = std::min<uint32_t>(chunk_count, index + 1 + CHUNK_READ_AHEAD);
+    for (auto i = index + 1; i < end; ++i) {
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            if (cache_map.find(i) != cache_map.end()) continue;
+        }
+        /* compressed data is read on this thread, as file handle is not shared */
+        std::vector<uint8_t> comp;
+        if (!read_compressed(i, comp)) break;
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            jobs.push_back({insert(i), std::move(comp)});
+        }
+        cond.notify_all();
+    }
+}
+
+void chunked_image_stream::worker_loop() {
+    std::unique_lock<std::mutex> lk(mtx);
+    while (true) {
+        cond.wait(lk, [this] { return stopping || !jobs.empty(); });
+        if (stopping) break;
+        auto j = std::move(jobs.front());
+        jobs.pop_front();
+        lk.unlock();
+        std::vector<uint8_t> data;
+        bool ok = decompress(j.target->index, j.comp, data);
+        lk.lock();
+        j.target->data = std::move(data);
+        j.target->failed = !ok;
+        j.target->ready = true;
+        cond.notify_all();
+    }
+}
+
+std::unique_ptr<vfs_stream> open_chunked_image(const std::string &path) {
+    if (!helper::file_exists(path)) return nullptr;
+    auto img = std::make_unique<chunked_image_stream>();
+    if (!img->open(path)) return nullptr;
+    return img;
+}
+
+/* compress `raw` into `comp`, keep raw data if it does not shrink */
+static void compress_chunk(const std::vector<uint8_t> &raw, std::vector<uint8_t> &comp, int level) {
+    mz_ulong comp_len = mz_compressBound(static_cast<mz_ulong>(raw.size()));
+    comp.resize(comp_len);
+    if (mz_compress2(comp.data(), &comp_len, raw.data(), static_cast<mz_ulong>(raw.size()), level) != MZ_OK
+        || comp_len >= raw.size()) {
+        comp = raw;
+        return;
+    }
+    comp.resize(comp_len);
+}
+
+bool chunked_image_create(const std::string &input, const std::string &output, uint32_t chunk_size, int level) {
+    if (chunk_size == 0 || chunk_size > CHUNKED_IMAGE_MAX_CHUNK_SIZE) return false;
+    auto *in = vfs_native_interface.open(input.c_str(), RETRO_VFS_FILE_ACCESS_READ, 0);
+    if (!in) {
+        LOG(Error, "unable to open {}", input);
+        return false;
+    }
+    auto raw_size = vfs_native_interface.size(in);
+    auto *out = raw_size < 0 ? nullptr : vfs_native_interface.open(output.c_str(), RETRO_VFS_FILE_ACCESS_WRITE, 0);
+    if (!out) {
+        LOG(Error, "unable to create {}", output);
+        vfs_native_interface.close(in);
+        return false;
+    }
+
+    auto chunk_count = static_cast<uint32_t>((static_cast<uint64_t>(raw_size) + chunk_size - 1) / chunk_size);
+    uint8_t header[CHUNKED_IMAGE_HEADER_SIZE] = {};
+    memcpy(header, chunked_image_magic, 4);
+    put_u32(header + 4, chunk_size);
+    put_u64(header + 8, static_cast<uint64_t>(raw_size));
+    put_u32(header + 16, chunk_count);
+    /* index is written after all chunks are written, leave room for it */
+    std::vector<uint8_t> table((size_t(chunk_count) + 1) * 8);
+    bool ok = write_full(out, header, sizeof(header)) && write_full(out, table.data(), table.size());
+
+    unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+    size_t batch = threads * CHUNK_CREATE_BATCH;
+    std::vector<std::vector<uint8_t>> raw(batch), comp(batch);
+    uint64_t out_pos = sizeof(header) + table.size();
+    for (uint32_t first = 0; ok && first < chunk_count; first += batch) {
+        auto count = static_cast<uint32_t>(std::min<size_t>(batch, chunk_count - first));
+        for (uint32_t i = 0; ok && i < count; ++i) {
+            raw[i].resize(static_cast<size_t>(std::min<uint64_t>(chunk_size, raw_size - uint64_t(first + i) * chunk_size)));
+            ok = read_full(in, raw[i].data(), raw[i].size());
+        }
+        if (!ok) break;
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads && t < count; ++t) {
+            pool.emplace_back([&, t] {
+                for (uint32_t i = t; i < count; i += threads) compress_chunk(raw[i], comp[i], level);
+            });
+        }
+        for (auto &th: pool) th.join();
+        for (uint32_t i = 0; ok && i < count; ++i) {
+            put_u64(&table[size_t(first + i) * 8], out_pos);
+            ok = write_full(out, comp[i].data(), comp[i].size());
+            out_pos += comp[i].size();
+        }
+    }
+    put_u64(&table[size_t(chunk_count) * 8], out_pos);
+    ok = ok && vfs_native_interface.seek(out, CHUNKED_IMAGE_HEADER_SIZE, RETRO_VFS_SEEK_POSITION_START) >= 0
+        && write_full(out, table.data(), table.size());
+
+    vfs_native_interface.close(in);
+    if (vfs_native_interface.close(out) != 0) ok = false;
+    if (!ok) {
+        LOG(Error, "failed to write chunked image {}", output);
+        vfs_native_interface.remove(output.c_str());
+        return false;
+    }
+    LOG(INFO, "{}: {} -> {} bytes in {} chunks", output, raw_size, out_pos, chunk_count);
+    return true;
+}
+
+}
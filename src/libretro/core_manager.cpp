@@ -3,64 +3,364 @@
 #include "cfg.h"
 
 #include "helper.h"
+#include "logger.h"
 
 #include "dlfcn_compat.h"
-#include <cstring>
+#include <json.hpp>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+
+using json = nlohmann::json;
 
 namespace libretro {
 
+enum :int {
+    /* bump this if format of cache file changes */
+    CORE_INFO_CACHE_VERSION = 1,
+    /* max number of probing worker processes */
+    CORE_PROBE_MAX_WORKERS = 8,
+    /* probes taking longer than this (in ms) are killed and retried on next launch */
+    CORE_PROBE_TIMEOUT = 15000,
+    /* fd in probing process which core info is written to */
+    CORE_PROBE_OUTPUT_FD = 3,
+};
+
+/* cache entry of a file in core dirs, non-core files are cached with `valid` = false
+ * so that they are not dlopen()ed on every launch either */
+struct core_cache_entry {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool valid = false;
+    core_info info = {};
+    /* probe timed out, do not list nor cache it */
+    bool timed_out = false;
+};
+
+static inline std::string lower_ext(const std::string &ext) {
+    std::string result(ext);
+    for (auto &c: result) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return result;
+}
+
+struct core_probe_request {
+    std::string filename;
+    std::string name;
+    core_cache_entry *entry;
+};
+
+static void load_core_cache(const std::string &filename, std::map<std::string, core_cache_entry> &cache) {
+    if (!helper::file_exists(filename)) return;
+    try {
+        std::string content;
+        if (!helper::read_file(filename, content)) {
+            throw std::bad_exception();
+        }
+        auto j = json::parse(content);
+        if (!j.is_object() || j.value("version", 0) != CORE_INFO_CACHE_VERSION) return;
+        for (auto &item: j.at("cores").items()) {
+            auto &v = item.value();
+            core_cache_entry entry;
+            entry.size = v.at("size").get<uint64_t>();
+            entry.mtime = v.at("mtime").get<int64_t>();
+            entry.valid = v.at("valid").get<bool>();
+            if (entry.valid) {
+                entry.info.filepath = item.key();
+                entry.info.name = v.at("name").get<std::string>();
+                entry.info.version = v.at("version").get<std::string>();
+                entry.info.extensions = v.at("extensions").get<std::vector<std::string>>();
+                entry.info.need_fullpath = v.at("need_fullpath").get<bool>();
+            }
+            cache[item.key()] = std::move(entry);
+        }
+    } catch(...) {
+        LOG(Error, "failed to read core info cache from {}", filename);
+        cache.clear();
+    }
+}
+
+static void save_core_cache(const std::string &filename, const std::map<std::string, core_cache_entry> &cache) {
+    json j;
+    j["version"] = CORE_INFO_CACHE_VERSION;
+    auto &cores = j["cores"] = json::object();
+    for (const auto &p: cache) {
+        auto &v = cores[p.first];
+        v["size"] = p.second.size;
+        v["mtime"] = p.second.mtime;
+        v["valid"] = p.second.valid;
+        if (p.second.valid) {
+            v["name"] = p.second.info.name;
+            v["version"] = p.second.info.version;
+            v["extensions"] = p.second.info.extensions;
+            v["need_fullpath"] = p.second.info.need_fullpath;
+        }
+    }
+    try {
+        auto content = j.dump();
+        if (!helper::write_file(filename, content))
+            throw std::bad_exception();
+    } catch(...) {
+        LOG(Error, "failed to write core info cache to {}", filename);
+    }
+}
+
+#ifdef _WIN32
+static void probe_cores(std::vector<core_probe_request> &pending) {
+    for (auto &req: pending) {
+        req.entry->valid = core_manager::probe_core(req.filename, req.name.c_str(), req.entry->info);
+    }
+}
+#else
+/* probe each core in a fresh process of this binary (`--probe-core`) which writes core info as json to a pipe,
+ * a core crashing or hanging in its static init only fails its own probe.
+ * fork() without exec is not used, as a lock held by logger or other threads at fork time would deadlock the child */
+static bool spawn_probe(const core_probe_request &req, pid_t &pid, int &fd) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) return false;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    /* dup2() clears close-on-exec of the target fd */
+    posix_spawn_file_actions_adddup2(&actions, fds[1], CORE_PROBE_OUTPUT_FD);
+    std::string filename = req.filename;
+    std::string name = req.name;
+    char arg0[] = "sdlretro";
+    char arg1[] = "--probe-core";
+    char *argv[] = {arg0, arg1, &filename[0], &name[0], nullptr};
+    int ret = posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (ret != 0) {
+        close(fds[0]);
+        return false;
+    }
+    fd = fds[0];
+    return true;
+}
+
+static void probe_cores(std::vector<core_probe_request> &pending) {
+    struct worker {
+        core_probe_request *req;
+        pid_t pid;
+        int fd;
+        uint64_t deadline;
+        std::string output;
+    };
+    size_t max_workers = std::max(1U, std::min<unsigned>(std::thread::hardware_concurrency(), CORE_PROBE_MAX_WORKERS));
+    std::vector<worker> workers;
+    size_t next = 0;
+    while (next < pending.size() || !workers.empty()) {
+        while (next < pending.size() && workers.size() < max_workers) {
+            auto &req = pending[next++];
+            pid_t pid;
+            int fd;
+            if (!spawn_probe(req, pid, fd)) {
+                /* unable to isolate the probe, do it in this process */
+                req.entry->valid = core_manager::probe_core(req.filename, req.name.c_str(), req.entry->info);
+                continue;
+            }
+            workers.push_back({&req, pid, fd, helper::get_ticks_usec() + CORE_PROBE_TIMEOUT * 1000ULL, {}});
+        }
+
+        std::vector<pollfd> pfds;
+        pfds.reserve(workers.size());
+        for (auto &w: workers) {
+            pfds.push_back({w.fd, POLLIN, 0});
+        }
+        if (pfds.empty()) continue;
+        poll(pfds.data(), pfds.size(), 100);
+
+        auto now = helper::get_ticks_usec();
+        for (size_t i = workers.size(); i-- > 0;) {
+            auto &w = workers[i];
+            bool finished = false;
+            if (pfds[i].revents) {
+                char buf[4096];
+                auto n = read(w.fd, buf, sizeof(buf));
+                if (n > 0) {
+                    w.output.append(buf, n);
+                } else {
+                    finished = true;
+                }
+            }
+            if (!finished && now < w.deadline) continue;
+
+            auto &entry = *w.req->entry;
+            if (finished) {
+                int status = 0;
+                waitpid(w.pid, &status, 0);
+                entry.valid = false;
+                if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                    try {
+                        auto j = json::parse(w.output);
+                        entry.info.filepath = w.req->filename;
+                        entry.info.name = j.at("name").get<std::string>();
+                        entry.info.version = j.at("version").get<std::string>();
+                        entry.info.extensions = j.at("extensions").get<std::vector<std::string>>();
+                        entry.info.need_fullpath = j.at("need_fullpath").get<bool>();
+                        entry.valid = true;
+                    } catch(...) {
+                    }
+                } else if (WIFSIGNALED(status)) {
+                    LOG(Error, "core {} crashed while probing", w.req->filename);
+                }
+            } else {
+                LOG(Error, "core {} timed out while probing", w.req->filename);
+                kill(w.pid, SIGKILL);
+                waitpid(w.pid, nullptr, 0);
+                entry.timed_out = true;
+            }
+            close(w.fd);
+            workers.erase(workers.begin() + i);
+        }
+    }
+}
+#endif
+
 core_manager::core_manager() {
     g_cfg.get_core_dirs(core_dirs);
+
+    /* only files which are new or changed since last launch get dlopen()ed,
+     * the cache is rebuilt from files found so entries of removed cores are dropped */
+    std::string cache_filename = g_cfg.get_store_dir() + PATH_SEPARATOR_CHAR + "core_info.json";
+    std::map<std::string, core_cache_entry> cache, new_cache;
+    load_core_cache(cache_filename, cache);
+    /* files in directory order, and files need to be probed */
+    std::vector<std::string> files;
+    std::vector<core_probe_request> pending;
+
     for (const auto &core_dir: core_dirs) {
         auto *dir = vfs_interface.opendir(core_dir.c_str(), false);
         if (!dir) continue;
         while (vfs_interface.readdir(dir)) {
+            if (vfs_interface.dirent_is_dir(dir)) continue;
             const char *name = vfs_interface.dirent_get_name(dir);
             std::string filename = core_dir;
             filename += PATH_SEPARATOR_CHAR;
             filename += name;
 
-            void *dynlib = dlopen(filename.c_str(), RTLD_LAZY);
-            if (dynlib == nullptr) continue;
-
-            typedef void (*sysinfo_t)(struct retro_system_info*);
-            auto sysinfo = (sysinfo_t)dlsym(dynlib, "retro_get_system_info");
-            if (!sysinfo) {
-                dlclose(dynlib);
-                continue;
+            core_cache_entry entry;
+            if (!helper::file_stat(filename, entry.size, entry.mtime)) continue;
+            auto ite = cache.find(filename);
+            bool cached = ite != cache.end() && ite->second.size == entry.size && ite->second.mtime == entry.mtime;
+            if (cached) {
+                entry = std::move(ite->second);
             }
-            retro_system_info info = {};
-            sysinfo(&info);
-
-            core_info coreinfo = {filename, info.library_name ? info.library_name : name, info.library_version ? info.library_version : "unknown"};
-            coreinfo.need_fullpath = info.need_fullpath;
-            std::string exts = info.valid_extensions ? info.valid_extensions : "";
-
-            dlclose(dynlib);
-
-            for (;;) {
-                auto pos = exts.find('|');
-                coreinfo.extensions.push_back(exts.substr(0, pos));
-                if (pos == std::string::npos) break;
-                exts = exts.substr(pos + 1);
+            auto &stored = new_cache[filename];
+            stored = std::move(entry);
+            files.push_back(filename);
+            if (!cached) {
+                pending.push_back({filename, name, &stored});
             }
-            cores.push_back(coreinfo);
         }
         vfs_interface.closedir(dir);
     }
-}
 
-std::vector<const core_info *> core_manager::match_cores_by_extension(const std::string &ext) {
-    std::vector<const core_info *> core_list;
+    bool dirty = !pending.empty() || new_cache.size() != cache.size();
+    if (!pending.empty()) {
+        probe_cores(pending);
+    }
+
+    for (const auto &filename: files) {
+        auto ite = new_cache.find(filename);
+        if (ite == new_cache.end()) continue;
+        if (ite->second.timed_out) {
+            new_cache.erase(ite);
+            continue;
+        }
+        if (ite->second.valid) {
+            cores.push_back(ite->second.info);
+        }
+    }
+
+    if (dirty) {
+        save_core_cache(cache_filename, new_cache);
+    }
+
     for (const auto &c: cores) {
         for (const auto &extension: c.extensions) {
-            if (strcasecmp(extension.c_str(), ext.c_str())==0) {
-                core_list.push_back(&c);
-                break;
-            }
+            auto &list = ext_index[lower_ext(extension)];
+            if (list.empty() || list.back() != &c) list.push_back(&c);
         }
     }
-    return core_list;
+}
+
+bool core_manager::probe_core(const std::string &filename, const char *name, core_info &coreinfo) {
+    void *dynlib = dlopen(filename.c_str(), RTLD_LAZY);
+    if (dynlib == nullptr) return false;
+
+    typedef void (*sysinfo_t)(struct retro_system_info*);
+    auto sysinfo = (sysinfo_t)dlsym(dynlib, "retro_get_system_info");
+    if (!sysinfo) {
+        dlclose(dynlib);
+        return false;
+    }
+    retro_system_info info = {};
+    sysinfo(&info);
+
+    coreinfo = {filename, info.library_name ? info.library_name : name, info.library_version ? info.library_version : "unknown"};
+    coreinfo.need_fullpath = info.need_fullpath;
+    std::string exts = info.valid_extensions ? info.valid_extensions : "";
+
+    dlclose(dynlib);
+
+    size_t start = 0;
+    for (;;) {
+        auto pos = exts.find('|', start);
+        coreinfo.extensions.emplace_back(exts, start, pos == std::string::npos ? std::string::npos : pos - start);
+        if (pos == std::string::npos) break;
+        start = pos + 1;
+    }
+    return true;
+}
+
+#ifndef _WIN32
+int core_manager::probe_core_process(const char *filename, const char *name) {
+    core_info info;
+    if (!probe_core(filename, name, info)) return 1;
+    json j;
+    j["name"] = info.name;
+    j["version"] = info.version;
+    j["extensions"] = info.extensions;
+    j["need_fullpath"] = info.need_fullpath;
+    auto content = j.dump();
+    const char *ptr = content.data();
+    size_t left = content.size();
+    while (left > 0) {
+        auto n = write(CORE_PROBE_OUTPUT_FD, ptr, left);
+        if (n <= 0) return 1;
+        ptr += n;
+        left -= n;
+    }
+    return 0;
+}
+#endif
+
+std::vector<const core_info *> core_manager::match_cores_by_extension(const std::string &ext) const {
+    auto ite = ext_index.find(lower_ext(ext));
+    if (ite == ext_index.end()) return {};
+    return ite->second;
+}
+
+std::vector<const std::vector<const core_info*>*> core_manager::match_cores_by_extensions(const std::vector<std::string> &exts) const {
+    std::vector<const std::vector<const core_info*>*> result;
+    result.reserve(exts.size());
+    for (const auto &ext: exts) {
+        auto ite = ext_index.find(lower_ext(ext));
+        result.push_back(ite == ext_index.end() ? nullptr : &ite->second);
+    }
+    return result;
 }
 
 }
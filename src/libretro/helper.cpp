@@ -1,12 +1,20 @@
 #include <helper.h>
 
 #include <ctime>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HELPER_USE_SSE2
+#endif
 
 #ifdef _WIN32
 #include <windows.h>
 #include <shlwapi.h>
 #else
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <errno.h>
 #endif
 
@@ -101,6 +109,87 @@ bool file_exists(const std::string &path) {
 #endif
 }
 
+bool file_stat(const std::string &path, uint64_t &size, int64_t &mtime) {
+#ifdef _WIN32
+    wchar_t wpath[MAX_PATH];
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath, MAX_PATH);
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wpath, GetFileExInfoStandard, &data)
+        || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+    size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    /* FILETIME is in 100ns units since 1601-01-01 */
+    uint64_t t = (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    mtime = static_cast<int64_t>(t / 10000000ULL) - 11644473600LL;
+#else
+    struct stat s = {};
+    if (stat(path.c_str(), &s) != 0 || !S_ISREG(s.st_mode)) return false;
+    size = static_cast<uint64_t>(s.st_size);
+    mtime = static_cast<int64_t>(s.st_mtime);
+#endif
+    return true;
+}
+
+bool mapped_file::open(const std::string &filename, bool writable) {
+    close();
+#ifdef _WIN32
+    wchar_t wpath[MAX_PATH];
+    MultiByteToWideChar(CP_UTF8, 0, filename.c_str(), -1, wpath, MAX_PATH);
+    HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    mapping = CreateFileMappingW(file, nullptr, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+    ptr = static_cast<uint8_t*>(MapViewOfFile(mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+    if (ptr == nullptr) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    sz = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat s = {};
+    if (fstat(fd, &s) != 0 || s.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, s.st_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    ptr = static_cast<uint8_t*>(p);
+    sz = static_cast<size_t>(s.st_size);
+#endif
+    return true;
+}
+
+void mapped_file::close() {
+    if (ptr == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(ptr);
+    CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    munmap(ptr, sz);
+#endif
+    ptr = nullptr;
+    sz = 0;
+}
+
+void mapped_file::prefetch() const {
+    if (ptr == nullptr) return;
+#ifdef _WIN32
+    /* PrefetchVirtualMemory() needs Windows 8+, the sequential scan flag on open does read-ahead already */
+#else
+    madvise(ptr, sz, MADV_WILLNEED);
+#endif
+}
+
 /* UTF-8 to UCS-4 */
 uint32_t utf8_to_ucs4(const char *&text) {
     auto c = static_cast<uint8_t>(*text);
@@ -181,4 +270,78 @@ uint32_t utf8_to_ucs4(const char *&text) {
     return 0;
 }
 
+void utf8_to_ucs2(const char *text, size_t len, std::vector<uint16_t> &out) {
+    /* output never has more codepoints than input bytes */
+    out.resize(len);
+    auto *dst = out.data();
+    const auto *src = reinterpret_cast<const uint8_t*>(text);
+    const auto *end = src + len;
+    while (src < end) {
+        /* fast path for runs of ASCII characters */
+#ifdef HELPER_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        while (end - src >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            if (_mm_movemask_epi8(v)) break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), _mm_unpackhi_epi8(v, zero));
+            src += 16;
+            dst += 16;
+        }
+#else
+        while (end - src >= 8) {
+            uint64_t v;
+            memcpy(&v, src, 8);
+            if (v & 0x8080808080808080ULL) break;
+            for (int i = 0; i < 8; ++i) {
+                dst[i] = src[i];
+            }
+            src += 8;
+            dst += 8;
+        }
+#endif
+        while (src < end && *src < 0x80) {
+            *dst++ = *src++;
+        }
+        if (src >= end) break;
+
+        uint32_t c = *src;
+        int follow;
+        uint32_t ch;
+        if (c < 0xC0) {
+            ++src;
+            continue;
+        } else if (c < 0xE0) {
+            follow = 1;
+            ch = c & 0x1Fu;
+        } else if (c < 0xF0) {
+            follow = 2;
+            ch = c & 0x0Fu;
+        } else if (c < 0xF8) {
+            follow = 3;
+            ch = c & 0x07u;
+        } else {
+            ++src;
+            continue;
+        }
+        if (end - src <= follow) break;
+        int i;
+        for (i = 1; i <= follow; ++i) {
+            uint32_t n = src[i];
+            if ((n & 0xC0u) != 0x80u) break;
+            ch = (ch << 6u) | (n & 0x3Fu);
+        }
+        if (i <= follow) {
+            /* broken sequence, resync from next byte */
+            ++src;
+            continue;
+        }
+        src += follow + 1;
+        if (ch != 0 && ch <= 0xFFFFu) {
+            *dst++ = static_cast<uint16_t>(ch);
+        }
+    }
+    out.resize(dst - out.data());
+}
+
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+namespace libretro {
+
+/* writes whole files on a background thread,
+ * each file is written to a temp file then renamed over the target,
+ * so that a crash never leaves a half-written file behind */
+class async_writer {
+public:
+    ~async_writer();
+
+    /* queue `data` to be written to `path`,
+     * replaces data queued for the same path which is not being written yet */
+    void write(const std::string &path, std::vector<uint8_t> &&data);
+    /* same as above, but `data` is shared with caller, which must not modify it while it is still referenced */
+    void write(const std::string &path, std::shared_ptr<const std::vector<uint8_t>> data);
+    /* wait until queued data of `path` is written */
+    void wait(const std::string &path);
+    /* wait until all queued data is written */
+    void wait_all();
+
+    /* write `data` to `path` through temp file and rename on calling thread */
+    static bool write_atomic(const std::string &path, const std::vector<uint8_t> &data);
+
+private:
+    void loop();
+
+    std::mutex mtx;
+    std::condition_variable cond, done_cond;
+    /* queued data by path, and path order to write */
+    std::map<std::string, std::shared_ptr<const std::vector<uint8_t>>> pending;
+    std::deque<std::string> order;
+    /* path being written by worker thread */
+    std::string writing;
+    std::thread thread;
+    bool stopping = false;
+};
+
+extern async_writer async_writer_obj;
+
+}
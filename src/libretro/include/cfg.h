@@ -46,6 +46,8 @@ public:
     inline void set_scaling_mode(uint32_t s) { scaling_mode = s; }
     inline int get_scale() const { return scale; }
     inline void set_scale(int s) { scale = s; }
+    inline bool get_dirty_rects() const { return dirty_rects; }
+    inline void set_dirty_rects(bool d) { dirty_rects = d; }
 
     inline bool get_integer_scaling() const { return integer_scaling; }
     inline void set_integer_scaling(bool s) { integer_scaling = s; }
@@ -54,10 +56,17 @@ public:
 
     inline uint32_t get_save_check() const { return save_check; }
     inline void set_save_check(uint32_t c) { save_check = c; }
+    inline bool get_sram_write_tracking() const { return sram_write_tracking; }
+    inline void set_sram_write_tracking(bool t) { sram_write_tracking = t; }
 
     inline int get_language() const { return language; }
     inline void set_language(int lang) { language = lang; }
 
+    inline bool get_vfs_prefetch() const { return vfs_prefetch; }
+    inline void set_vfs_prefetch(bool p) { vfs_prefetch = p; }
+    inline bool get_vfs_stats() const { return vfs_stats; }
+    inline void set_vfs_stats(bool s) { vfs_stats = s; }
+
 protected:
     /* config filename */
     std::string config_filename;
@@ -92,10 +101,16 @@ protected:
     /* === SDL1-only options === */
     /* scaling mode
      * 0  IPU scaling
-     * 1  Screen center */
+     * 1  Screen center
+     * 2  Scale2x/Scale3x filter by scale, then IPU scaling
+     * 3  xBR-lite filter (scale 2 only), then IPU scaling
+     * 4  Bilinear software scaling to screen size, keeps aspect ratio */
     uint32_t scaling_mode = 0;
     /* basic integer scaler */
     int scale = DEFAULT_SCALE;
+    /* only copy and present changed 16-line bands of game frames,
+     * used with IPU scaling and screen center modes on software surfaces */
+    bool dirty_rects = false;
 
     /* === SDL2-only options === */
     /* allow only integer scaling (will trim down to nearest integer scaling ratio),
@@ -104,13 +119,22 @@ protected:
     /* use hardware linear rendering */
     bool linear = true;
 
-    /* save check interval in seconds, set to 0 to disable it */
+    /* max delay in seconds between sram/rtc change and saving it, set to 0 to only save on game unload,
+     * changes are saved earlier once the memory stops changing */
     uint32_t save_check = 0;
+    /* detect sram/rtc changes by write-protecting its pages instead of hashing them (Linux only),
+     * off by default: cores reading files directly into sram with read() would get EFAULT */
+    bool sram_write_tracking = false;
 
     /* ui langauge
      * check enum retro_language in libretro.h
      * */
     int language;
+
+    /* prefetch ahead of files being read sequentially in a background thread */
+    bool vfs_prefetch = true;
+    /* collect per-file I/O statistics and dump them to log on exit */
+    bool vfs_stats = false;
 };
 
 extern cfg g_cfg;
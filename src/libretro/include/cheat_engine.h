@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+namespace libretro {
+
+struct memory_region;
+
+/* cheats loaded from RetroArch style .cht file,
+ * native codes are handed to core by retro_cheat_set(),
+ * RAM cheats are compiled into a list of writes sorted by host address,
+ * with adjacent bytes coalesced into runs, applied after each retro_run() */
+class cheat_engine {
+public:
+    struct cheat {
+        std::string desc;
+        std::string code;
+        bool enabled;
+        /* written by frontend to RAM instead of handed to core */
+        bool ram;
+        size_t address;
+        uint32_t value;
+        /* value size in bytes */
+        uint32_t size;
+        bool big_endian;
+        uint32_t repeat_count;
+        uint32_t repeat_add_to_value;
+        uint32_t repeat_add_to_address;
+        /* all fields read from file, written back on save */
+        std::map<std::string, std::string> fields;
+    };
+
+    /* load cheats from file, return false if file does not exist or has no cheat */
+    bool load(const std::string &filename);
+    /* write cheats back to file loaded, or to `filename` if set */
+    void save(const std::string &filename = std::string());
+    void clear();
+
+    inline const std::vector<cheat> &get_cheats() const { return cheats; }
+    void set_enabled(size_t index, bool enabled);
+    /* add an enabled RAM cheat which sets `size` bytes at `address` to `value` */
+    void add_ram_cheat(const std::string &desc, size_t address, uint32_t value, uint32_t size, bool big_endian);
+
+    /* pass enabled native codes to core */
+    void apply_codes(void (*cheat_reset)(), void (*cheat_set)(unsigned, bool, const char*)) const;
+
+    /* RAM writes need to be compiled again, after cheats or memory maps changed */
+    inline void invalidate() { dirty = true; }
+    inline bool need_compile() const { return dirty; }
+    /* translate addresses of RAM cheats to host pointers through `regions`, sorted by address,
+     * which must be the same regions cheat search works on */
+    void compile(const std::vector<memory_region> &regions);
+    /* write values of RAM cheats, runs are split into 1/2/4/8-byte stores at compile time,
+     * so that each loop is a plain store without branching on size */
+    inline void apply() const {
+        apply_writes(writes64);
+        apply_writes(writes32);
+        apply_writes(writes16);
+        apply_writes(writes8);
+    }
+
+private:
+    template <typename T>
+    struct fixed_write {
+        uint8_t *dst;
+        /* bytes in memory order */
+        T value;
+    };
+
+    template <typename T>
+    static inline void add_write(std::vector<fixed_write<T>> &writes, uint8_t *dst, const uint8_t *src) {
+        fixed_write<T> w = {dst, 0};
+        memcpy(&w.value, src, sizeof(T));
+        writes.push_back(w);
+    }
+    template <typename T>
+    static inline void apply_writes(const std::vector<fixed_write<T>> &writes) {
+        for (const auto &w: writes) {
+            memcpy(w.dst, &w.value, sizeof(T));
+        }
+    }
+
+    std::string path;
+    std::vector<cheat> cheats;
+    std::vector<fixed_write<uint64_t>> writes64;
+    std::vector<fixed_write<uint32_t>> writes32;
+    std::vector<fixed_write<uint16_t>> writes16;
+    std::vector<fixed_write<uint8_t>> writes8;
+    bool dirty = false;
+};
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "memory_map.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace libretro {
+
+/* RAM search for finding cheat addresses,
+ * values are aligned to value size within each region, candidates are kept as bitmaps,
+ * and each search compares all candidates with previous snapshot or a constant in a single pass */
+class cheat_search {
+public:
+    enum value_size :uint32_t {
+        size_8 = 1,
+        size_16 = 2,
+        size_32 = 4,
+    };
+    enum compare_op :uint32_t {
+        cmp_equal = 0,
+        cmp_not_equal,
+        cmp_less,
+        cmp_greater,
+        cmp_less_equal,
+        cmp_greater_equal,
+    };
+    struct result {
+        size_t address;
+        int64_t value;
+        int64_t previous;
+    };
+
+    /* take snapshot of `regions`, all values are candidates */
+    void start(const std::vector<memory_region> &regions, value_size size, bool is_signed, bool big_endian);
+    void clear();
+
+    /* keep candidates whose current value compares by `op` to its previous value, or to `value` if `with_value`,
+     * `value` is truncated to value size, snapshot is updated with current values.
+     * pointers of regions are refreshed from `regions`, return false and stop search if layout changed */
+    bool filter(const std::vector<memory_region> &regions, compare_op op, bool with_value, int64_t value);
+
+    inline bool active() const { return !blocks.empty(); }
+    inline size_t get_count() const { return count; }
+    inline value_size get_size() const { return size; }
+    inline bool get_signed() const { return is_signed; }
+    inline bool get_big_endian() const { return big_endian; }
+    /* fill first `max` candidates */
+    void get_results(std::vector<result> &results, size_t max) const;
+
+private:
+    struct block {
+        memory_region region;
+        size_t elements;
+        /* values at last search */
+        std::vector<uint8_t> snapshot;
+        /* one bit per element, set if element is still a candidate */
+        std::vector<uint64_t> bits;
+    };
+
+    int64_t read_value(const uint8_t *p) const;
+
+    std::vector<block> blocks;
+    size_t count = 0;
+    value_size size = size_8;
+    bool is_signed = false;
+    bool big_endian = false;
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/* chunked compressed image, `file.srz` is served through VFS as `file`:
+ *   header:  "SRZ1", u32 chunk size, u64 raw size, u32 chunk count, u32 reserved
+ *   index:   u64 file offset of each chunk, plus one for end of last chunk
+ *   chunks:  zlib stream of each chunk, or raw data if compression does not shrink it
+ * all integers are little-endian */
+#define CHUNKED_IMAGE_EXTENSION ".srz"
+
+namespace libretro {
+
+enum :uint32_t {
+    CHUNKED_IMAGE_DEFAULT_CHUNK_SIZE = 256U * 1024U,
+};
+
+/* compress `input` into chunked image `output`, chunks are compressed in parallel */
+bool chunked_image_create(const std::string &input, const std::string &output,
+                          uint32_t chunk_size = CHUNKED_IMAGE_DEFAULT_CHUNK_SIZE, int level = 6);
+
+}
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 namespace libretro {
 
@@ -17,13 +18,30 @@ class core_manager final {
 public:
     core_manager();
     ~core_manager() = default;
+    /* ext_index points into cores */
+    core_manager(const core_manager&) = delete;
+    core_manager &operator=(const core_manager&) = delete;
 
     /* match libretro cores by rom file extention */
-    std::vector<const core_info*> match_cores_by_extension(const std::string &ext);
+    std::vector<const core_info*> match_cores_by_extension(const std::string &ext) const;
+    /* match cores for many extensions at once (e.g. scanning a rom directory),
+     * result[i] is the core list for exts[i], nullptr for no match,
+     * pointers stay valid during lifetime of core_manager */
+    std::vector<const std::vector<const core_info*>*> match_cores_by_extensions(const std::vector<std::string> &exts) const;
+
+    /* dlopen() core and query retro_get_system_info(), return false if not a libretro core */
+    static bool probe_core(const std::string &filename, const char *name, core_info &coreinfo);
+#ifndef _WIN32
+    /* entry of `--probe-core <filename> <name>` process spawned by core_manager,
+     * writes core info of probe_core() as json to fd 3, return exit code */
+    static int probe_core_process(const char *filename, const char *name);
+#endif
 
 private:
     std::vector<std::string> core_dirs;
     std::vector<core_info> cores;
+    /* lower-cased extension => cores supporting it */
+    std::unordered_map<std::string, std::vector<const core_info*>> ext_index;
 };
 
 }
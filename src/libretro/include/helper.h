@@ -3,6 +3,7 @@
 #include "libretro.h"
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #ifdef _MSC_VER
@@ -15,6 +16,10 @@
 
 namespace libretro {
 extern struct retro_vfs_interface vfs_interface;
+/* same as vfs_interface, but files opened for writing are written back in background, given to cores */
+extern struct retro_vfs_interface vfs_core_interface;
+/* log per-file I/O statistics of closed files, collected if `vfs_stats` is enabled in cfg */
+void vfs_dump_stats();
 }
 
 #ifdef _WIN32
@@ -32,7 +37,39 @@ uint64_t get_ticks_usec_cache();
 uint64_t get_ticks_perfcounter();
 int mkdir(const std::string &path, bool recursive = false);
 bool file_exists(const std::string &path);
+/* get size and last modification time (seconds since epoch) of a regular file */
+bool file_stat(const std::string &path, uint64_t &size, int64_t &mtime);
 uint32_t utf8_to_ucs4(const char *&text);
+/* decode a whole UTF-8 string into BMP codepoints,
+ * invalid sequences and codepoints outside BMP are skipped */
+void utf8_to_ucs2(const char *text, size_t len, std::vector<uint16_t> &out);
+
+/* memory mapped file, opened read-only,
+ * set `writable` to get a private copy-on-write mapping
+ * which never writes back to the file */
+class mapped_file {
+public:
+    mapped_file() = default;
+    ~mapped_file() { close(); }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file &operator=(const mapped_file&) = delete;
+
+    bool open(const std::string &filename, bool writable = false);
+    void close();
+    /* hint the OS to start reading the whole mapping in ahead of access */
+    void prefetch() const;
+
+    inline uint8_t *data() const { return ptr; }
+    inline size_t size() const { return sz; }
+    inline bool empty() const { return sz == 0; }
+
+private:
+    uint8_t *ptr = nullptr;
+    size_t sz = 0;
+#ifdef _WIN32
+    void *mapping = nullptr;
+#endif
+};
 
 template<typename T>
 inline bool read_file(const std::string &filename, T &data) {
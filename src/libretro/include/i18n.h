@@ -19,6 +19,8 @@ struct xxh_hasher {
 
 class i18n {
 public:
+    using text_map = std::unordered_map<std::string, std::string, xxh_hasher>;
+
     static void get_language_list(std::vector<language_info> &info_list);
 
     bool load_language_file(int lang);
@@ -27,12 +29,15 @@ public:
 
     const char *get_text(const char *t);
 
+    /* localized text vector of current language, nullptr for English */
+    inline const text_map *get_current_texts() const { return current; }
+
 private:
     /* localized text vectors indexed by language */
-    std::map<int, std::unordered_map<std::string, std::string, xxh_hasher>> localized_text;
+    std::map<int, text_map> localized_text;
 
     /* current localized text vector */
-    std::unordered_map<std::string, std::string, xxh_hasher> *current = nullptr;
+    text_map *current = nullptr;
 };
 
 extern i18n i18n_obj;
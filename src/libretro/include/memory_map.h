@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+struct retro_memory_map;
+
+namespace libretro {
+
+/* memory descriptor from RETRO_ENVIRONMENT_SET_MEMORY_MAPS,
+ * with `select`, `disconnect` and `len` normalized to be used directly */
+struct memory_descriptor {
+    uint64_t flags;
+    uint8_t *ptr;
+    size_t offset;
+    size_t start;
+    size_t select;
+    size_t disconnect;
+    size_t len;
+    std::string addrspace;
+};
+
+/* block of host memory at `address` of cheat address space */
+struct memory_region {
+    uint8_t *ptr;
+    size_t size;
+    size_t address;
+};
+
+/* translates emulated addresses to host pointers,
+ * each address space is compiled into a two-level page table,
+ * pages not mapped linearly by a single descriptor fall back to walking descriptors */
+class memory_map {
+public:
+    /* store descriptors and build page tables, return false if descriptors are invalid */
+    bool set(const retro_memory_map *map);
+    void clear();
+
+    inline bool empty() const { return spaces.empty(); }
+    inline const std::vector<memory_descriptor> &get_descriptors() const { return descriptors; }
+
+    /* host pointer of byte at `address` of unnamed address space, nullptr if unmapped */
+    inline uint8_t *translate(size_t address) const {
+        return main_space ? main_space->translate(address, descriptors) : nullptr;
+    }
+    uint8_t *translate(const std::string &addrspace, size_t address) const;
+    /* descriptor mapping `address` of unnamed address space, nullptr if unmapped */
+    const memory_descriptor *find_descriptor(size_t address) const;
+    /* blocks of descriptors flagged as system RAM, laid out back to back from address 0 in the order given by core,
+     * which is how RetroArch addresses RAM in cheat search and .cht files */
+    inline void get_ram_regions(std::vector<memory_region> &regions) const { regions = ram_regions; }
+
+private:
+    enum :uint32_t {
+        /* each second-level table holds 2^TABLE_BITS pages */
+        TABLE_BITS = 10,
+        PAGE_UNMAPPED = 0,
+        /* page is not mapped linearly, walk descriptors */
+        PAGE_SLOW = UINT32_MAX,
+    };
+    struct page_entry {
+        /* host pointer of first byte in page */
+        uint8_t *base;
+        /* index of descriptor + 1, or PAGE_UNMAPPED/PAGE_SLOW */
+        uint32_t desc;
+    };
+    struct space {
+        std::string name;
+        /* indices of descriptors in this space, in priority order */
+        std::vector<uint32_t> desc_indices;
+        uint32_t page_bits = 0;
+        size_t table_top = 0;
+        std::vector<std::unique_ptr<page_entry[]>> tables;
+
+        inline uint8_t *translate(size_t address, const std::vector<memory_descriptor> &descs) const {
+            if (address <= table_top) {
+                const auto *table = tables[address >> (page_bits + TABLE_BITS)].get();
+                if (!table) return nullptr;
+                const auto &e = table[(address >> page_bits) & ((1U << TABLE_BITS) - 1)];
+                if (e.desc != PAGE_SLOW) return e.base ? e.base + (address & ((size_t(1) << page_bits) - 1)) : nullptr;
+            }
+            return translate_slow(address, descs, nullptr);
+        }
+        uint8_t *translate_slow(size_t address, const std::vector<memory_descriptor> &descs, uint32_t *index) const;
+        void build(const std::vector<memory_descriptor> &descs);
+    };
+
+    std::vector<memory_descriptor> descriptors;
+    std::vector<memory_region> ram_regions;
+    std::vector<space> spaces;
+    const space *main_space = nullptr;
+};
+
+}
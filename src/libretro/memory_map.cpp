@@ -0,0 +1,238 @@
+#include "memory_map.h"
+
+#include "logger.h"
+
+#include <libretro.h>
+
+#include <algorithm>
+
+namespace libretro {
+
+enum :uint32_t {
+    /* largest page, smaller pages are used if descriptors map finer than this */
+    MEMORY_MAP_MAX_PAGE_BITS = 12,
+    /* max pages in page tables of an address space, larger pages are used beyond this */
+    MEMORY_MAP_MAX_PAGES = 1U << 22,
+    /* addresses above this are always translated by walking descriptors */
+    MEMORY_MAP_MAX_TABLE_TOP = 0xFFFFFFFFU,
+};
+
+/* bit helpers as described in libretro.h for retro_memory_descriptor */
+static inline size_t add_bits_down(size_t n) {
+    n |= n >> 1;
+    n |= n >> 2;
+    n |= n >> 4;
+    n |= n >> 8;
+    n |= n >> 16;
+    if (sizeof(size_t) > 4) n |= n >> 16 >> 16;
+    return n;
+}
+
+static inline size_t highest_bit(size_t n) {
+    n = add_bits_down(n);
+    return n ^ (n >> 1);
+}
+
+static inline uint32_t lowest_bit_index(size_t n) {
+    uint32_t index = 0;
+    while (!(n & 1)) {
+        n >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+/* insert zero bits into `addr` at positions set in `mask` */
+static size_t inflate(size_t addr, size_t mask) {
+    while (mask) {
+        size_t tmp = (mask - 1) & ~mask;
+        addr = ((addr & ~tmp) << 1) | (addr & tmp);
+        mask = mask & (mask - 1);
+    }
+    return addr;
+}
+
+/* remove bits at positions set in `mask` from `addr` */
+static size_t reduce(size_t addr, size_t mask) {
+    while (mask) {
+        size_t tmp = (mask - 1) & ~mask;
+        addr = (addr & tmp) | ((addr >> 1) & ~tmp);
+        mask = (mask & (mask - 1)) >> 1;
+    }
+    return addr;
+}
+
+/* fill in `select` and `len` where they are left zero, and extend `disconnect` to cover bits above `len`,
+ * drop descriptors which can not be normalized */
+static void preprocess_descriptors(std::vector<memory_descriptor> &descs) {
+    size_t top_addr = 1;
+    for (const auto &d: descs) {
+        top_addr |= d.select ? d.select : d.start + d.len - 1;
+    }
+    top_addr = add_bits_down(top_addr);
+    for (auto ite = descs.begin(); ite != descs.end();) {
+        auto &d = *ite;
+        if (!d.select) {
+            if (!d.len || (d.len & (d.len - 1))) {
+                LOG(WARN, "memory map: dropped descriptor at 0x{:x}, len 0x{:x} is not a power of two", d.start, d.len);
+                ite = descs.erase(ite);
+                continue;
+            }
+            d.select = top_addr & ~inflate(add_bits_down(d.len - 1), d.disconnect);
+        }
+        if (!d.len) {
+            d.len = add_bits_down(reduce(top_addr & ~d.select, d.disconnect)) + 1;
+        }
+        if (d.start & ~d.select) {
+            LOG(WARN, "memory map: dropped descriptor at 0x{:x}, start has bits outside select 0x{:x}", d.start, d.select);
+            ite = descs.erase(ite);
+            continue;
+        }
+        while (reduce(top_addr & ~d.select, d.disconnect) >> 1 > d.len - 1) {
+            d.disconnect |= highest_bit(top_addr & ~d.select & ~d.disconnect);
+        }
+        size_t disconnect_mask = add_bits_down(d.len - 1);
+        d.disconnect &= disconnect_mask;
+        while ((~disconnect_mask >> 1) & d.disconnect) {
+            disconnect_mask >>= 1;
+            d.disconnect &= disconnect_mask;
+        }
+        ++ite;
+    }
+}
+
+bool memory_map::set(const retro_memory_map *map) {
+    clear();
+    if (!map || !map->descriptors) return false;
+    size_t ram_size = 0;
+    for (unsigned i = 0; i < map->num_descriptors; ++i) {
+        const auto &src = map->descriptors[i];
+        /* same as RetroArch, `offset` is not applied */
+        if ((src.flags & RETRO_MEMDESC_SYSTEM_RAM) && src.ptr && src.len) {
+            ram_regions.push_back({static_cast<uint8_t*>(src.ptr), src.len, ram_size});
+            ram_size += src.len;
+        }
+        descriptors.push_back({src.flags, static_cast<uint8_t*>(src.ptr), src.offset, src.start,
+                               src.select, src.disconnect, src.len, src.addrspace ? src.addrspace : ""});
+    }
+    /* normalize descriptors within each address space, keeping their order */
+    std::stable_sort(descriptors.begin(), descriptors.end(), [](const memory_descriptor &a, const memory_descriptor &b) {
+        return a.addrspace < b.addrspace;
+    });
+    std::vector<memory_descriptor> result;
+    for (size_t first = 0; first < descriptors.size();) {
+        size_t last = first;
+        while (last < descriptors.size() && descriptors[last].addrspace == descriptors[first].addrspace) ++last;
+        std::vector<memory_descriptor> descs(descriptors.begin() + first, descriptors.begin() + last);
+        preprocess_descriptors(descs);
+        if (!descs.empty()) {
+            spaces.emplace_back();
+            auto &sp = spaces.back();
+            sp.name = descs.front().addrspace;
+            for (auto &d: descs) {
+                sp.desc_indices.push_back(static_cast<uint32_t>(result.size()));
+                result.push_back(std::move(d));
+            }
+        }
+        first = last;
+    }
+    descriptors = std::move(result);
+    for (auto &sp: spaces) {
+        sp.build(descriptors);
+        if (sp.name.empty()) main_space = &sp;
+    }
+    return !spaces.empty();
+}
+
+void memory_map::clear() {
+    main_space = nullptr;
+    spaces.clear();
+    descriptors.clear();
+    ram_regions.clear();
+}
+
+uint8_t *memory_map::translate(const std::string &addrspace, size_t address) const {
+    for (const auto &sp: spaces) {
+        if (sp.name == addrspace) return sp.translate(address, descriptors);
+    }
+    return nullptr;
+}
+
+const memory_descriptor *memory_map::find_descriptor(size_t address) const {
+    if (!main_space) return nullptr;
+    uint32_t index;
+    main_space->translate_slow(address, descriptors, &index);
+    return index < descriptors.size() ? &descriptors[index] : nullptr;
+}
+
+uint8_t *memory_map::space::translate_slow(size_t address, const std::vector<memory_descriptor> &descs, uint32_t *index) const {
+    for (auto i: desc_indices) {
+        const auto &d = descs[i];
+        if ((address & d.select) != d.start) continue;
+        /* first descriptor claiming the address applies, even if it maps nothing */
+        if (index) *index = i;
+        if (!d.ptr) return nullptr;
+        size_t offset = reduce(address - d.start, d.disconnect);
+        while (offset >= d.len) offset &= ~highest_bit(offset);
+        return d.ptr + d.offset + offset;
+    }
+    if (index) *index = PAGE_SLOW;
+    return nullptr;
+}
+
+void memory_map::space::build(const std::vector<memory_descriptor> &descs) {
+    /* pages must not be larger than the finest granularity of any descriptor to be mapped linearly */
+    uint32_t bits = MEMORY_MAP_MAX_PAGE_BITS;
+    size_t top = 0;
+    for (auto i: desc_indices) {
+        const auto &d = descs[i];
+        top |= d.select | d.start;
+        if (d.select) bits = std::min(bits, lowest_bit_index(d.select));
+        if (d.disconnect) bits = std::min(bits, lowest_bit_index(d.disconnect));
+        if (d.len & (d.len - 1)) bits = std::min(bits, lowest_bit_index(d.len));
+    }
+    top = std::min<size_t>(add_bits_down(top), MEMORY_MAP_MAX_TABLE_TOP);
+    while ((top >> bits) >= MEMORY_MAP_MAX_PAGES) ++bits;
+    page_bits = bits;
+    table_top = top;
+
+    size_t page_size = size_t(1) << bits;
+    size_t group_size = page_size << TABLE_BITS;
+    size_t table_count = (top >> (bits + TABLE_BITS)) + 1;
+    tables.clear();
+    tables.resize(table_count);
+    for (size_t t = 0; t < table_count; ++t) {
+        size_t group_start = t * group_size;
+        /* skip groups which no descriptor with memory can map into */
+        bool candidate = false;
+        for (auto i: desc_indices) {
+            const auto &d = descs[i];
+            if (d.ptr && ((group_start ^ d.start) & d.select & ~(group_size - 1)) == 0) {
+                candidate = true;
+                break;
+            }
+        }
+        if (!candidate) continue;
+        auto &table = tables[t];
+        table.reset(new page_entry[size_t(1) << TABLE_BITS]());
+        for (size_t p = 0; p < (size_t(1) << TABLE_BITS); ++p) {
+            size_t addr = group_start + p * page_size;
+            if (addr > top || addr < group_start) break;
+            uint32_t first_index, last_index;
+            auto *first = translate_slow(addr, descs, &first_index);
+            auto *last = translate_slow(addr + page_size - 1, descs, &last_index);
+            auto &e = table[p];
+            if (first_index != last_index || (first != nullptr) != (last != nullptr)) {
+                e = {nullptr, PAGE_SLOW};
+            } else if (!first) {
+                e = {nullptr, PAGE_UNMAPPED};
+            } else if (static_cast<size_t>(last - first) == page_size - 1) {
+                e = {first, first_index + 1};
+            } else {
+                e = {nullptr, PAGE_SLOW};
+            }
+        }
+    }
+}
+
+}
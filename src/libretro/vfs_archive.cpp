@@ -0,0 +1,575 @@
+#include "vfs_stream.h"
+#include "chunked_image.h"
+#include "async_writer.h"
+
+#include "helper.h"
+
+#include <miniz.h>
+
+#include <memory>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#define access _access
+#define W_OK 2
+#else
+#include <unistd.h>
+#endif
+
+/* VFS layer serving entries of zip archives as read-only files,
+ * paths are like `dir/game.zip#track01.bin` or `dir/game.zip/track01.bin`,
+ * and `file` from chunked image `file.srz` if `file` itself does not exist,
+ * everything else is passed to native VFS (vfs_unix.cpp/vfs_win32.cpp).
+ * files opened for writing by cores are buffered in memory and written back by async_writer */
+
+namespace libretro {
+
+enum :uint64_t {
+    /* output distance between saved inflate states for seeking backwards */
+    ARCHIVE_SEEK_POINT_INTERVAL = 2ULL << 20,
+    /* compressed data read at a time */
+    ARCHIVE_INPUT_BUFFER_SIZE = 64ULL << 10,
+    /* files opened for writing by cores are written directly once larger than this */
+    WRITEBACK_MAX_SIZE = 16ULL << 20,
+};
+
+/* snapshot of inflate progress, the dictionary holds the last 32KB of output,
+ * which is all tinfl needs to resume from here */
+struct inflate_state {
+    tinfl_decompressor decomp;
+    uint64_t in_pos;
+    uint64_t out_pos;
+    tinfl_status status;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];
+};
+
+class archive_entry_stream: public vfs_stream {
+public:
+    ~archive_entry_stream() override {
+        if (file) vfs_native_interface.close(file);
+    }
+
+    bool open(const std::string &archive_path, const std::string &entry_name);
+
+    uint64_t size() const override { return uncomp_size; }
+    int64_t read(void *buf, uint64_t len) override;
+
+private:
+    bool read_raw(uint64_t offset, void *buf, size_t len);
+    /* inflate more output into dictionary, return false on end of stream or error */
+    bool inflate_step();
+    /* make output at `target` available in dictionary window */
+    bool inflate_to(uint64_t target);
+
+private:
+    retro_vfs_file_handle *file = nullptr;
+    uint64_t data_offset = 0;
+    uint64_t comp_size = 0;
+    uint64_t uncomp_size = 0;
+    bool deflated = false;
+
+    /* inflate state and saved states at every ARCHIVE_SEEK_POINT_INTERVAL of output */
+    std::unique_ptr<inflate_state> state;
+    std::vector<std::unique_ptr<inflate_state>> seek_points;
+    std::vector<uint8_t> in_buf;
+    uint64_t in_buf_pos = 0;
+    size_t in_buf_size = 0;
+};
+
+static size_t archive_read_func(void *opaque, mz_uint64 ofs, void *buf, size_t n) {
+    auto *file = static_cast<retro_vfs_file_handle*>(opaque);
+    if (vfs_native_interface.seek(file, static_cast<int64_t>(ofs), RETRO_VFS_SEEK_POSITION_START) < 0) return 0;
+    auto res = vfs_native_interface.read(file, buf, n);
+    return res < 0 ? 0 : static_cast<size_t>(res);
+}
+
+bool archive_entry_stream::open(const std::string &archive_path, const std::string &entry_name) {
+    file = vfs_native_interface.open(archive_path.c_str(), RETRO_VFS_FILE_ACCESS_READ, 0);
+    if (!file) return false;
+    auto archive_size = vfs_native_interface.size(file);
+    if (archive_size <= 0) return false;
+
+    /* only central directory is parsed here, entry data is read through `file` later */
+    mz_zip_archive zip = {};
+    zip.m_pRead = archive_read_func;
+    zip.m_pIO_opaque = file;
+    if (!mz_zip_reader_init(&zip, static_cast<mz_uint64>(archive_size), 0)) return false;
+    mz_zip_archive_file_stat st;
+    int index = mz_zip_reader_locate_file(&zip, entry_name.c_str(), nullptr, 0);
+    bool ok = index >= 0 && mz_zip_reader_file_stat(&zip, index, &st)
+        && !st.m_is_directory && !st.m_is_encrypted && (st.m_method == 0 || st.m_method == MZ_DEFLATED);
+    mz_zip_reader_end(&zip);
+    if (!ok) return false;
+
+    /* skip local header: 30 bytes fixed part, then file name and extra field */
+    uint8_t header[30];
+    if (!read_raw(st.m_local_header_ofs, header, sizeof(header))
+        || header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4) return false;
+    data_offset = st.m_local_header_ofs + sizeof(header)
+        + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8));
+    comp_size = st.m_comp_size;
+    uncomp_size = st.m_uncomp_size;
+    deflated = st.m_method == MZ_DEFLATED;
+    if (deflated) {
+        state = std::make_unique<inflate_state>();
+        tinfl_init(&state->decomp);
+        state->in_pos = 0;
+        state->out_pos = 0;
+        state->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+        seek_points.emplace_back(std::make_unique<inflate_state>(*state));
+        in_buf.resize(ARCHIVE_INPUT_BUFFER_SIZE);
+    }
+    return true;
+}
+
+int64_t archive_entry_stream::read(void *buf, uint64_t len) {
+    if (pos >= uncomp_size) return 0;
+    if (len > uncomp_size - pos) len = uncomp_size - pos;
+    auto *out = static_cast<uint8_t*>(buf);
+    if (!deflated) {
+        if (!read_raw(data_offset + pos, out, len)) return -1;
+        pos += len;
+        return static_cast<int64_t>(len);
+    }
+    uint64_t total = 0;
+    while (len > 0) {
+        if (!inflate_to(pos)) break;
+        /* copy what is available in dictionary window, up to its wrap point */
+        size_t dict_pos = pos & (TINFL_LZ_DICT_SIZE - 1);
+        uint64_t avail = std::min<uint64_t>(state->out_pos - pos, TINFL_LZ_DICT_SIZE - dict_pos);
+        if (avail > len) avail = len;
+        memcpy(out, state->dict + dict_pos, avail);
+        out += avail;
+        pos += avail;
+        len -= avail;
+        total += avail;
+    }
+    return total ? static_cast<int64_t>(total) : -1;
+}
+
+bool archive_entry_stream::read_raw(uint64_t offset, void *buf, size_t len) {
+    if (vfs_native_interface.seek(file, static_cast<int64_t>(offset), RETRO_VFS_SEEK_POSITION_START) < 0) return false;
+    return vfs_native_interface.read(file, buf, len) == static_cast<int64_t>(len);
+}
+
+bool archive_entry_stream::inflate_step() {
+    if (state->status == TINFL_STATUS_DONE || state->status < 0) return false;
+    if (state->in_pos < in_buf_pos || state->in_pos >= in_buf_pos + in_buf_size) {
+        if (state->in_pos >= comp_size) {
+            in_buf_pos = state->in_pos;
+            in_buf_size = 0;
+        } else {
+            in_buf_pos = state->in_pos;
+            in_buf_size = static_cast<size_t>(std::min<uint64_t>(comp_size - in_buf_pos, in_buf.size()));
+            if (!read_raw(data_offset + in_buf_pos, in_buf.data(), in_buf_size)) {
+                in_buf_size = 0;
+                return false;
+            }
+        }
+    }
+    size_t in_off = static_cast<size_t>(state->in_pos - in_buf_pos);
+    size_t in_bytes = in_buf_size - in_off;
+    size_t dict_ofs = state->out_pos & (TINFL_LZ_DICT_SIZE - 1);
+    size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+    bool more_input = in_buf_pos + in_buf_size < comp_size;
+    state->status = tinfl_decompress(&state->decomp, in_buf.data() + in_off, &in_bytes,
+                                     state->dict, state->dict + dict_ofs, &out_bytes,
+                                     more_input ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+    state->in_pos += in_bytes;
+    auto old_out = state->out_pos;
+    state->out_pos += out_bytes;
+    if (state->status < 0) return false;
+
+    /* save a seek point when output crosses next interval boundary */
+    if (state->out_pos / ARCHIVE_SEEK_POINT_INTERVAL != old_out / ARCHIVE_SEEK_POINT_INTERVAL
+        && seek_points.back()->out_pos / ARCHIVE_SEEK_POINT_INTERVAL < state->out_pos / ARCHIVE_SEEK_POINT_INTERVAL) {
+        seek_points.emplace_back(std::make_unique<inflate_state>(*state));
+    }
+    return in_bytes > 0 || out_bytes > 0 || state->status == TINFL_STATUS_DONE;
+}
+
+bool archive_entry_stream::inflate_to(uint64_t target) {
+    uint64_t window = std::min<uint64_t>(state->out_pos, TINFL_LZ_DICT_SIZE);
+    if (target < state->out_pos - window) {
+        /* behind the window, resume from the nearest seek point before target */
+        size_t i = seek_points.size();
+        while (i > 1 && seek_points[i - 1]->out_pos > target) --i;
+        *state = *seek_points[i - 1];
+    }
+    while (target >= state->out_pos) {
+        if (!inflate_step()) return target < state->out_pos;
+    }
+    return true;
+}
+
+/* file opened for writing by core, kept in memory and queued to async_writer on flush and close,
+ * so that cores saving memory cards do not wait for storage on emulation thread,
+ * the buffer is shared with async_writer on flush and only copied if written again before it is on storage,
+ * files growing past WRITEBACK_MAX_SIZE are written to native file directly from then on */
+class writeback_stream: public vfs_stream {
+public:
+    writeback_stream(const std::string &p, std::vector<uint8_t> &&content, bool created):
+        path(p), data(std::make_shared<std::vector<uint8_t>>(std::move(content))), dirty(created) {}
+    ~writeback_stream() override {
+        if (native) {
+            vfs_native_interface.close(native);
+        } else if (dirty) {
+            async_writer_obj.write(path, std::move(data));
+        }
+    }
+
+    uint64_t size() const override {
+        return native ? static_cast<uint64_t>(vfs_native_interface.size(native)) : data->size();
+    }
+    int64_t read(void *buf, uint64_t len) override {
+        if (pos >= size()) return 0;
+        if (native) {
+            if (vfs_native_interface.seek(native, static_cast<int64_t>(pos), RETRO_VFS_SEEK_POSITION_START) < 0) return -1;
+            auto res = vfs_native_interface.read(native, buf, len);
+            if (res > 0) pos += res;
+            return res;
+        }
+        len = std::min<uint64_t>(len, data->size() - pos);
+        memcpy(buf, data->data() + pos, static_cast<size_t>(len));
+        pos += len;
+        return static_cast<int64_t>(len);
+    }
+    int64_t write(const void *buf, uint64_t len) override {
+        if (!native && pos + len > WRITEBACK_MAX_SIZE && !open_native()) return -1;
+        if (native) {
+            if (vfs_native_interface.seek(native, static_cast<int64_t>(pos), RETRO_VFS_SEEK_POSITION_START) < 0) return -1;
+            auto res = vfs_native_interface.write(native, buf, len);
+            if (res > 0) pos += res;
+            return res;
+        }
+        own_data();
+        if (pos + len > data->size()) data->resize(static_cast<size_t>(pos + len));
+        memcpy(data->data() + pos, buf, static_cast<size_t>(len));
+        pos += len;
+        dirty = true;
+        return static_cast<int64_t>(len);
+    }
+    int64_t truncate(int64_t length) override {
+        if (length < 0) return -1;
+        if (!native && static_cast<uint64_t>(length) > WRITEBACK_MAX_SIZE && !open_native()) return -1;
+        if (native) return vfs_native_interface.truncate(native, length);
+        own_data();
+        data->resize(static_cast<size_t>(length));
+        dirty = true;
+        return 0;
+    }
+    int flush() override {
+        if (native) return vfs_native_interface.flush(native);
+        if (dirty) {
+            async_writer_obj.write(path, data);
+            dirty = false;
+        }
+        return 0;
+    }
+
+private:
+    /* copy buffer before modifying it if async_writer still holds it */
+    void own_data() {
+        if (data.use_count() > 1) {
+            data = std::make_shared<std::vector<uint8_t>>(*data);
+        } else {
+            /* pairs with release of the buffer by writer thread */
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+    }
+    /* write buffered content to native file, which is used for all operations from now on */
+    bool open_native() {
+        /* content flushed before must not land on top of what is written directly */
+        async_writer_obj.wait(path);
+        native = vfs_native_interface.open(path.c_str(), RETRO_VFS_FILE_ACCESS_READ_WRITE, 0);
+        if (!native) return false;
+        if (!data->empty() && vfs_native_interface.write(native, data->data(), data->size()) != static_cast<int64_t>(data->size())) {
+            vfs_native_interface.close(native);
+            native = nullptr;
+            return false;
+        }
+        data.reset();
+        dirty = false;
+        return true;
+    }
+
+    std::string path;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    retro_vfs_file_handle *native = nullptr;
+    bool dirty;
+};
+
+/* layered file handle, passed to cores as retro_vfs_file_handle */
+struct vfs_layer_file {
+    std::string path;
+    retro_vfs_file_handle *native = nullptr;
+    std::unique_ptr<vfs_stream> stream;
+};
+
+static inline vfs_layer_file *layer_file(retro_vfs_file_handle *stream) {
+    return reinterpret_cast<vfs_layer_file*>(stream);
+}
+
+/* split `path` into archive path and entry name, separated by '#' or a path separator after `.zip` */
+static bool split_archive_path(const char *path, std::string &archive_path, std::string &entry_name) {
+    size_t len = strlen(path);
+    for (size_t i = 4; i < len; ++i) {
+        char c = path[i];
+        if (c != '#' && c != '/' && c != '\\') continue;
+        if (path[i - 4] != '.' || tolower(path[i - 3]) != 'z' || tolower(path[i - 2]) != 'i' || tolower(path[i - 1]) != 'p') continue;
+        archive_path.assign(path, i);
+        if (!helper::file_exists(archive_path)) continue;
+        entry_name.assign(path + i + 1);
+        /* zip entries always use '/' as separator */
+        for (auto &ch: entry_name) if (ch == '\\') ch = '/';
+        return !entry_name.empty();
+    }
+    return false;
+}
+
+const char *RETRO_CALLCONV archive_vfs_get_path(struct retro_vfs_file_handle *stream) {
+    return layer_file(stream)->path.c_str();
+}
+
+/* async_writer creates `path`.tmp and renames it over `path`, check permissions it needs at open time,
+ * so that a core sees the failure from open instead of the writer thread logging it later */
+static bool can_write_back(const char *path) {
+    if (helper::file_exists(path) && access(path, W_OK) != 0) return false;
+    std::string dir(path);
+    auto pos = dir.find_last_of("/\\");
+    if (pos == std::string::npos) {
+        dir = ".";
+    } else {
+        dir.resize(pos == 0 ? 1 : pos);
+    }
+    return access(dir.c_str(), W_OK) == 0;
+}
+
+/* open file for writing in memory, return nullptr if it should be written directly,
+ * which is also how failures are reported, as native open fails in the same way */
+static std::unique_ptr<writeback_stream> open_writeback(const char *path, unsigned mode) {
+    if (!can_write_back(path)) return nullptr;
+    std::vector<uint8_t> content;
+    if (mode & RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING) {
+        auto *native = vfs_native_interface.open(path, RETRO_VFS_FILE_ACCESS_READ, 0);
+        if (!native) return nullptr;
+        auto size = vfs_native_interface.size(native);
+        bool ok = size >= 0 && static_cast<uint64_t>(size) <= WRITEBACK_MAX_SIZE;
+        if (ok) {
+            content.resize(static_cast<size_t>(size));
+            ok = size == 0 || vfs_native_interface.read(native, content.data(), content.size()) == size;
+        }
+        vfs_native_interface.close(native);
+        if (!ok) return nullptr;
+    }
+    return std::make_unique<writeback_stream>(path, std::move(content), !(mode & RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING));
+}
+
+static struct retro_vfs_file_handle *layer_open(const char *path, unsigned mode, unsigned hints, bool writeback) {
+    std::unique_ptr<vfs_layer_file> ret;
+    std::string archive_path, entry_name;
+    bool read_only = !(mode & RETRO_VFS_FILE_ACCESS_WRITE);
+    std::unique_ptr<writeback_stream> wb;
+    if (!read_only && writeback && (wb = open_writeback(path, mode))) {
+        ret = std::make_unique<vfs_layer_file>();
+        ret->stream = std::move(wb);
+    } else if (read_only && split_archive_path(path, archive_path, entry_name)) {
+        auto arc = std::make_unique<archive_entry_stream>();
+        if (!arc->open(archive_path, entry_name)) return nullptr;
+        ret = std::make_unique<vfs_layer_file>();
+        ret->stream = std::move(arc);
+    } else {
+        auto *native = vfs_native_interface.open(path, mode, hints);
+        if (native) {
+            ret = std::make_unique<vfs_layer_file>();
+            ret->native = native;
+        } else {
+            if (!read_only) return nullptr;
+            auto img = open_chunked_image(std::string(path) + CHUNKED_IMAGE_EXTENSION);
+            if (!img) return nullptr;
+            ret = std::make_unique<vfs_layer_file>();
+            ret->stream = std::move(img);
+        }
+    }
+    ret->path = path;
+    return reinterpret_cast<retro_vfs_file_handle*>(ret.release());
+}
+
+struct retro_vfs_file_handle *RETRO_CALLCONV archive_vfs_open(const char *path, unsigned mode, unsigned hints) {
+    return layer_open(path, mode, hints, false);
+}
+
+int RETRO_CALLCONV archive_vfs_close(struct retro_vfs_file_handle *stream) {
+    if (!stream) return -1;
+    auto *f = layer_file(stream);
+    int res = f->native ? vfs_native_interface.close(f->native) : 0;
+    delete f;
+    return res;
+}
+
+int64_t RETRO_CALLCONV archive_vfs_size(struct retro_vfs_file_handle *stream) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.size(f->native) : static_cast<int64_t>(f->stream->size());
+}
+
+int64_t RETRO_CALLCONV archive_vfs_truncate(struct retro_vfs_file_handle *stream, int64_t length) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.truncate(f->native, length) : f->stream->truncate(length);
+}
+
+int64_t RETRO_CALLCONV archive_vfs_tell(struct retro_vfs_file_handle *stream) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.tell(f->native) : f->stream->tell();
+}
+
+int64_t RETRO_CALLCONV archive_vfs_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.seek(f->native, offset, seek_position) : f->stream->seek(offset, seek_position);
+}
+
+int64_t RETRO_CALLCONV archive_vfs_read(struct retro_vfs_file_handle *stream, void *s, uint64_t len) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.read(f->native, s, len) : f->stream->read(s, len);
+}
+
+int64_t RETRO_CALLCONV archive_vfs_write(struct retro_vfs_file_handle *stream, const void *s, uint64_t len) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.write(f->native, s, len) : f->stream->write(s, len);
+}
+
+int RETRO_CALLCONV archive_vfs_flush(struct retro_vfs_file_handle *stream) {
+    auto *f = layer_file(stream);
+    return f->native ? vfs_native_interface.flush(f->native) : f->stream->flush();
+}
+
+int RETRO_CALLCONV archive_vfs_stat(const char *path, int32_t *size) {
+    std::string archive_path, entry_name;
+    if (split_archive_path(path, archive_path, entry_name)) {
+        archive_entry_stream arc;
+        if (!arc.open(archive_path, entry_name)) return 0;
+        if (size) *size = static_cast<int32_t>(arc.size());
+        return RETRO_VFS_STAT_IS_VALID;
+    }
+    int res = vfs_native_interface.stat(path, size);
+    if (res == 0) {
+        auto img = open_chunked_image(std::string(path) + CHUNKED_IMAGE_EXTENSION);
+        if (!img) return 0;
+        if (size) *size = static_cast<int32_t>(img->size());
+        return RETRO_VFS_STAT_IS_VALID;
+    }
+    return res;
+}
+
+/* functions not touching file handles are passed to native VFS */
+int RETRO_CALLCONV archive_vfs_remove(const char *path) {
+    return vfs_native_interface.remove(path);
+}
+
+int RETRO_CALLCONV archive_vfs_rename(const char *old_path, const char *new_path) {
+    return vfs_native_interface.rename(old_path, new_path);
+}
+
+int RETRO_CALLCONV archive_vfs_mkdir(const char *dir) {
+    return vfs_native_interface.mkdir(dir);
+}
+
+struct retro_vfs_dir_handle *RETRO_CALLCONV archive_vfs_opendir(const char *dir, bool include_hidden) {
+    return vfs_native_interface.opendir(dir, include_hidden);
+}
+
+bool RETRO_CALLCONV archive_vfs_readdir(struct retro_vfs_dir_handle *dirstream) {
+    return vfs_native_interface.readdir(dirstream);
+}
+
+const char *RETRO_CALLCONV archive_vfs_dirent_get_name(struct retro_vfs_dir_handle *dirstream) {
+    return vfs_native_interface.dirent_get_name(dirstream);
+}
+
+bool RETRO_CALLCONV archive_vfs_dirent_is_dir(struct retro_vfs_dir_handle *dirstream) {
+    return vfs_native_interface.dirent_is_dir(dirstream);
+}
+
+int RETRO_CALLCONV archive_vfs_closedir(struct retro_vfs_dir_handle *dirstream) {
+    return vfs_native_interface.closedir(dirstream);
+}
+
+/* functions given to cores, buffering files opened for writing,
+ * functions taking paths wait for pending writes of the path first */
+struct retro_vfs_file_handle *RETRO_CALLCONV core_vfs_open(const char *path, unsigned mode, unsigned hints) {
+    async_writer_obj.wait(path);
+    return layer_open(path, mode, hints, true);
+}
+
+int RETRO_CALLCONV core_vfs_remove(const char *path) {
+    async_writer_obj.wait(path);
+    return vfs_native_interface.remove(path);
+}
+
+int RETRO_CALLCONV core_vfs_rename(const char *old_path, const char *new_path) {
+    async_writer_obj.wait(old_path);
+    async_writer_obj.wait(new_path);
+    return vfs_native_interface.rename(old_path, new_path);
+}
+
+int RETRO_CALLCONV core_vfs_stat(const char *path, int32_t *size) {
+    async_writer_obj.wait(path);
+    return archive_vfs_stat(path, size);
+}
+
+struct retro_vfs_interface vfs_interface = {
+    /* VFS API v1 */
+    archive_vfs_get_path,
+    archive_vfs_open,
+    archive_vfs_close,
+    archive_vfs_size,
+    archive_vfs_tell,
+    archive_vfs_seek,
+    archive_vfs_read,
+    archive_vfs_write,
+    archive_vfs_flush,
+    archive_vfs_remove,
+    archive_vfs_rename,
+    /* VFS API v2 */
+    archive_vfs_truncate,
+    /* VFS API v3 */
+    archive_vfs_stat,
+    archive_vfs_mkdir,
+    archive_vfs_opendir,
+    archive_vfs_readdir,
+    archive_vfs_dirent_get_name,
+    archive_vfs_dirent_is_dir,
+    archive_vfs_closedir,
+};
+
+struct retro_vfs_interface vfs_core_interface = {
+    /* VFS API v1 */
+    archive_vfs_get_path,
+    core_vfs_open,
+    archive_vfs_close,
+    archive_vfs_size,
+    archive_vfs_tell,
+    archive_vfs_seek,
+    archive_vfs_read,
+    archive_vfs_write,
+    archive_vfs_flush,
+    core_vfs_remove,
+    core_vfs_rename,
+    /* VFS API v2 */
+    archive_vfs_truncate,
+    /* VFS API v3 */
+    core_vfs_stat,
+    archive_vfs_mkdir,
+    archive_vfs_opendir,
+    archive_vfs_readdir,
+    archive_vfs_dirent_get_name,
+    archive_vfs_dirent_is_dir,
+    archive_vfs_closedir,
+};
+
+}
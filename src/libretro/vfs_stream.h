@@ -0,0 +1,45 @@
+#pragma once
+
+#include <libretro.h>
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace libretro {
+
+extern struct retro_vfs_interface vfs_native_interface;
+
+/* stream served by VFS layer in place of a native file, read-only unless write functions are overridden */
+class vfs_stream {
+public:
+    virtual ~vfs_stream() = default;
+
+    virtual uint64_t size() const = 0;
+    virtual int64_t read(void *buf, uint64_t len) = 0;
+    virtual int64_t write(const void*, uint64_t) { return -1; }
+    virtual int64_t truncate(int64_t) { return -1; }
+    virtual int flush() { return 0; }
+
+    inline int64_t tell() const { return static_cast<int64_t>(pos); }
+    int64_t seek(int64_t offset, int seek_position) {
+        int64_t base;
+        switch (seek_position) {
+        case RETRO_VFS_SEEK_POSITION_START: base = 0; break;
+        case RETRO_VFS_SEEK_POSITION_CURRENT: base = static_cast<int64_t>(pos); break;
+        case RETRO_VFS_SEEK_POSITION_END: base = static_cast<int64_t>(size()); break;
+        default: return -1;
+        }
+        if (base + offset < 0) return -1;
+        pos = static_cast<uint64_t>(base + offset);
+        return static_cast<int64_t>(pos);
+    }
+
+protected:
+    uint64_t pos = 0;
+};
+
+/* open chunked compressed image (see chunked_image.h), return nullptr on error */
+std::unique_ptr<vfs_stream> open_chunked_image(const std::string &path);
+
+}
@@ -1,6 +1,8 @@
 #ifdef VFS_UNIX
 
-#include "util.h"
+#include "helper.h"
+#include "cfg.h"
+#include "logger.h"
 
 #include <libretro.h>
 
@@ -11,6 +13,14 @@
 #include <cstdio>
 #include <dirent.h>
 
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+
 #ifdef WIN32
 #define fsync
 #endif
@@ -18,9 +28,58 @@
 #define O_BINARY 0
 #endif
 
+enum :uint32_t {
+    /* bytes prefetched ahead of sequential reads */
+    VFS_PREFETCH_WINDOW = 1024U * 1024U,
+    /* contiguous reads before a file is considered streamed */
+    VFS_SEQUENTIAL_READS = 2,
+    /* max pending prefetch requests, newer ones are dropped */
+    VFS_PREFETCH_QUEUE_SIZE = 16,
+    /* read latency histogram buckets, first one is <16us, each next one is 4x wider */
+    VFS_LATENCY_BUCKETS = 8,
+};
+
+namespace libretro {
+
+/* I/O statistics of a file, collected if `vfs_stats` is enabled in cfg */
+struct vfs_io_stats {
+    uint64_t reads = 0;
+    uint64_t read_bytes = 0;
+    uint64_t writes = 0;
+    uint64_t write_bytes = 0;
+    uint64_t seeks = 0;
+    uint64_t prefetches = 0;
+    uint64_t read_usec = 0;
+    uint64_t latency[VFS_LATENCY_BUCKETS] = {};
+
+    void merge(const vfs_io_stats &other) {
+        reads += other.reads;
+        read_bytes += other.read_bytes;
+        writes += other.writes;
+        write_bytes += other.write_bytes;
+        seeks += other.seeks;
+        prefetches += other.prefetches;
+        read_usec += other.read_usec;
+        for (uint32_t i = 0; i < VFS_LATENCY_BUCKETS; ++i) latency[i] += other.latency[i];
+    }
+};
+
+}
+
 struct retro_vfs_file_handle {
     char filename[PATH_MAX + 1];
     int file_handle;
+    /* file position, reads and writes use pread()/pwrite() at this offset */
+    int64_t pos;
+    /* cached file size, -1 if not queried yet */
+    int64_t size;
+    /* end of last read and number of contiguous reads, to detect streaming access */
+    int64_t last_read_end;
+    uint32_t sequential_reads;
+    /* data before this offset is already requested to be prefetched */
+    int64_t prefetched_end;
+    bool prefetch;
+    std::unique_ptr<libretro::vfs_io_stats> stats;
 };
 
 struct retro_vfs_dir_handle {
@@ -32,6 +91,122 @@ struct retro_vfs_dir_handle {
 
 namespace libretro {
 
+/* closed files' statistics, merged by path */
+static std::mutex stats_mutex;
+static std::map<std::string, vfs_io_stats> closed_stats;
+
+/* background thread reading ahead of streamed files into page cache,
+ * so that a slow storage does not stall the reading thread on every buffer refill */
+class vfs_prefetcher {
+public:
+    ~vfs_prefetcher() {
+        {
+            std::unique_lock<std::mutex> lk(mtx);
+            if (!thread.joinable()) return;
+            stopping = true;
+        }
+        cond.notify_one();
+        thread.join();
+        for (auto &j: jobs) close(j.fd);
+    }
+
+    /* fd is duplicated, so the file can be closed while prefetching */
+    bool push(int fd, int64_t offset, int64_t len) {
+        std::unique_lock<std::mutex> lk(mtx);
+        if (stopping || jobs.size() >= VFS_PREFETCH_QUEUE_SIZE) return false;
+        int dupfd = dup(fd);
+        if (dupfd < 0) return false;
+        if (!thread.joinable()) thread = std::thread(&vfs_prefetcher::loop, this);
+        jobs.push_back({dupfd, offset, len});
+        lk.unlock();
+        cond.notify_one();
+        return true;
+    }
+
+private:
+    struct job {
+        int fd;
+        int64_t offset;
+        int64_t len;
+    };
+
+    void loop() {
+        std::unique_lock<std::mutex> lk(mtx);
+        while (true) {
+            cond.wait(lk, [this] { return stopping || !jobs.empty(); });
+            if (stopping) break;
+            auto j = jobs.front();
+            jobs.pop_front();
+            lk.unlock();
+#ifdef __linux__
+            readahead(j.fd, j.offset, static_cast<size_t>(j.len));
+#elif defined(POSIX_FADV_WILLNEED)
+            posix_fadvise(j.fd, j.offset, j.len, POSIX_FADV_WILLNEED);
+#endif
+            close(j.fd);
+            lk.lock();
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::deque<job> jobs;
+    std::thread thread;
+    bool stopping = false;
+};
+
+static vfs_prefetcher prefetcher;
+
+static inline int64_t file_size(struct retro_vfs_file_handle *stream) {
+    if (stream->size < 0) {
+        struct stat s;
+        if (fstat(stream->file_handle, &s) == 0) stream->size = s.st_size;
+    }
+    return stream->size;
+}
+
+/* track contiguous reads and keep prefetching ahead once a file is being streamed */
+static void check_prefetch(struct retro_vfs_file_handle *stream, int64_t offset, int64_t len) {
+    if (offset != stream->last_read_end) {
+        stream->sequential_reads = 0;
+        stream->prefetched_end = 0;
+        stream->last_read_end = offset + len;
+        return;
+    }
+    stream->last_read_end = offset + len;
+    if (++stream->sequential_reads < VFS_SEQUENTIAL_READS) return;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (stream->sequential_reads == VFS_SEQUENTIAL_READS) {
+        /* let kernel use a larger read-ahead window as well */
+        posix_fadvise(stream->file_handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    auto end = stream->last_read_end;
+    /* request next window when half of the previous one is consumed */
+    if (end + VFS_PREFETCH_WINDOW / 2 <= stream->prefetched_end) return;
+    auto start = std::max(end, stream->prefetched_end);
+    auto size = file_size(stream);
+    auto stop = std::min<int64_t>(end + VFS_PREFETCH_WINDOW, size);
+    if (start >= stop) return;
+    if (prefetcher.push(stream->file_handle, start, stop - start)) {
+        stream->prefetched_end = stop;
+        if (stream->stats) ++stream->stats->prefetches;
+    }
+}
+
+void vfs_dump_stats() {
+    std::unique_lock<std::mutex> lk(stats_mutex);
+    for (const auto &p: closed_stats) {
+        const auto &st = p.second;
+        LOG(INFO, "vfs: {}: {} reads ({} bytes, {} us), {} writes ({} bytes), {} seeks, {} prefetches",
+            p.first, st.reads, st.read_bytes, st.read_usec, st.writes, st.write_bytes, st.seeks, st.prefetches);
+        if (!st.reads) continue;
+        LOG(INFO, "vfs:   read latency <16us:{} <64us:{} <256us:{} <1ms:{} <4ms:{} <16ms:{} <64ms:{} >=64ms:{}",
+            st.latency[0], st.latency[1], st.latency[2], st.latency[3],
+            st.latency[4], st.latency[5], st.latency[6], st.latency[7]);
+    }
+}
+
 const char *RETRO_CALLCONV unix_vfs_get_path(struct retro_vfs_file_handle *stream) {
     return stream->filename;
 }
@@ -53,51 +228,87 @@ struct retro_vfs_file_handle *RETRO_CALLCONV unix_vfs_open(const char *path, uns
             flag |= O_RDWR;
         }
     }
-    ret->file_handle = open(path, flag);
+    ret->file_handle = open(path, flag, 0644);
     if (ret->file_handle < 0) {
         delete ret;
         return nullptr;
     }
     snprintf(ret->filename, PATH_MAX + 1, "%s", path);
+    ret->pos = 0;
+    ret->size = -1;
+    ret->last_read_end = -1;
+    ret->sequential_reads = 0;
+    ret->prefetched_end = 0;
+    ret->prefetch = g_cfg.get_vfs_prefetch() && (flag & O_ACCMODE) == O_RDONLY;
+    if (g_cfg.get_vfs_stats()) ret->stats = std::make_unique<vfs_io_stats>();
     return ret;
 }
 
 int RETRO_CALLCONV unix_vfs_close(struct retro_vfs_file_handle *stream) {
     if (!stream) return -1;
     close(stream->file_handle);
+    if (stream->stats) {
+        std::unique_lock<std::mutex> lk(stats_mutex);
+        closed_stats[stream->filename].merge(*stream->stats);
+    }
     delete stream;
     return 0;
 }
 
 int64_t RETRO_CALLCONV unix_vfs_size(struct retro_vfs_file_handle *stream) {
-    auto off = lseek64(stream->file_handle, 0, SEEK_CUR);
-    auto res = lseek64(stream->file_handle, 0, SEEK_END);
-    lseek64(stream->file_handle, off, SEEK_SET);
-    return res;
+    return file_size(stream);
 }
 
 int64_t RETRO_CALLCONV unix_vfs_truncate(struct retro_vfs_file_handle *stream, int64_t length) {
-    return ftruncate(stream->file_handle, length);
+    auto res = ftruncate(stream->file_handle, length);
+    stream->size = res == 0 ? length : -1;
+    return res;
 }
 
 int64_t RETRO_CALLCONV unix_vfs_tell(struct retro_vfs_file_handle *stream) {
-    return lseek64(stream->file_handle, 0, SEEK_CUR);
+    return stream->pos;
 }
 
-int64_t unix_vfs_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position) {
-    return lseek64(stream->file_handle, offset, seek_position);
+int64_t RETRO_CALLCONV unix_vfs_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position) {
+    int64_t base;
+    switch (seek_position) {
+    case RETRO_VFS_SEEK_POSITION_START: base = 0; break;
+    case RETRO_VFS_SEEK_POSITION_CURRENT: base = stream->pos; break;
+    case RETRO_VFS_SEEK_POSITION_END:
+        base = file_size(stream);
+        if (base < 0) return -1;
+        break;
+    default: return -1;
+    }
+    if (base + offset < 0) return -1;
+    if (stream->stats) ++stream->stats->seeks;
+    stream->pos = base + offset;
+    return stream->pos;
 }
 
 int64_t RETRO_CALLCONV unix_vfs_read(struct retro_vfs_file_handle *stream, void *s, uint64_t len) {
     auto *buf = static_cast<uint8_t*>(s);
     int64_t res = 0;
+    uint64_t start_usec = stream->stats ? helper::get_ticks_usec() : 0;
     while (len > 0) {
-        auto read_bytes = read(stream->file_handle, buf, len > 0xFFFFFFFCULL ? 0xFFFFFFFCU : static_cast<unsigned>(len));
+        auto read_bytes = pread(stream->file_handle, buf, len > 0xFFFFFFFCULL ? 0xFFFFFFFCU : static_cast<unsigned>(len), stream->pos + res);
         if (read_bytes <= 0) break;
         res += read_bytes;
         buf += read_bytes;
         len -= read_bytes;
     }
+    if (stream->stats) {
+        auto usec = helper::get_ticks_usec() - start_usec;
+        auto &st = *stream->stats;
+        ++st.reads;
+        st.read_bytes += res;
+        st.read_usec += usec;
+        uint32_t bucket = 0;
+        for (uint64_t limit = 16; bucket < VFS_LATENCY_BUCKETS - 1 && usec >= limit; limit <<= 2) ++bucket;
+        ++st.latency[bucket];
+    }
+    if (stream->prefetch && res > 0) check_prefetch(stream, stream->pos, res);
+    stream->pos += res;
     return res ? res : -1;
 }
 
@@ -105,12 +316,18 @@ int64_t RETRO_CALLCONV unix_vfs_write(struct retro_vfs_file_handle *stream, cons
     const auto *buf = static_cast<const uint8_t*>(s);
     int64_t res = 0;
     while (len > 0) {
-        auto read_bytes = write(stream->file_handle, buf, len > 0xFFFFFFFCULL ? 0xFFFFFFFCU : static_cast<unsigned>(len));
+        auto read_bytes = pwrite(stream->file_handle, buf, len > 0xFFFFFFFCULL ? 0xFFFFFFFCU : static_cast<unsigned>(len), stream->pos + res);
         if (read_bytes <= 0) break;
         res += read_bytes;
         buf += read_bytes;
         len -= read_bytes;
     }
+    if (stream->stats) {
+        ++stream->stats->writes;
+        stream->stats->write_bytes += res;
+    }
+    stream->pos += res;
+    if (stream->size >= 0 && stream->pos > stream->size) stream->size = stream->pos;
     return res ? res : -1;
 }
 
@@ -134,7 +351,7 @@ int RETRO_CALLCONV unix_vfs_stat(const char *path, int32_t *size) {
 }
 
 int RETRO_CALLCONV unix_vfs_mkdir(const char *dir) {
-    return util::mkdir(dir);
+    return helper::mkdir(dir);
 }
 
 struct retro_vfs_dir_handle *RETRO_CALLCONV unix_vfs_opendir(const char *dir, bool include_hidden) {
@@ -167,6 +384,11 @@ const char *RETRO_CALLCONV unix_vfs_dirent_get_name(struct retro_vfs_dir_handle
 }
 
 bool RETRO_CALLCONV unix_vfs_dirent_is_dir(struct retro_vfs_dir_handle *dirstream) {
+#ifdef DT_DIR
+    /* d_type saves a stat() per entry, symlinks and some filesystems still need stat() */
+    auto type = dirstream->data->d_type;
+    if (type != DT_UNKNOWN && type != DT_LNK) return type == DT_DIR;
+#endif
     char path[PATH_MAX + 1];
     snprintf(path, PATH_MAX + 1, "%s/%s", dirstream->dirname, dirstream->data->d_name);
     struct stat s;
@@ -180,7 +402,8 @@ int RETRO_CALLCONV unix_vfs_closedir(struct retro_vfs_dir_handle *dirstream) {
     return res;
 }
 
-struct retro_vfs_interface vfs_interface = {
+/* wrapped by archive layer in vfs_archive.cpp */
+struct retro_vfs_interface vfs_native_interface = {
     /* VFS API v1 */
     unix_vfs_get_path,
     unix_vfs_open,
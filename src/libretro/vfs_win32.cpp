@@ -152,7 +152,8 @@ int RETRO_CALLCONV win32_vfs_rename(const char *old_path, const char *new_path)
     wchar_t new_filenamew[MAX_PATH + 1];
     if (!FileNameUTF8ToUCS(old_path, old_filenamew)) return -1;
     if (!FileNameUTF8ToUCS(new_path, new_filenamew)) return -1;
-    return MoveFileW(old_filenamew, new_filenamew) ? 0 : -1;
+    /* replace existing file like rename() on POSIX, async_writer relies on it */
+    return MoveFileExW(old_filenamew, new_filenamew, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
 }
 
 #ifndef S_ISCHR
@@ -219,7 +220,11 @@ int RETRO_CALLCONV win32_vfs_closedir(struct retro_vfs_dir_handle *dirstream) {
     return res ? 0 : -1;
 }
 
-struct retro_vfs_interface vfs_interface = {
+void vfs_dump_stats() {
+}
+
+/* wrapped by archive layer in vfs_archive.cpp */
+struct retro_vfs_interface vfs_native_interface = {
     /* VFS API v1 */
     win32_vfs_get_path,
     win32_vfs_open,
@@ -13,7 +13,9 @@
 #include <helper.h>
 #include <ui_host.h>
 #include <cfg.h>
+#include <chunked_image.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
@@ -29,9 +31,11 @@
 int program(int argc, char *argv[]) {
     const char *core_filename = nullptr;
     const char *config_filename = nullptr;
+    const char *compress_filename = nullptr;
     static struct option long_options[] = {
         {"libretro",     required_argument, 0,  'L' },
         {"config",     required_argument, 0,  'c' },
+        {"compress-image",     required_argument, 0,  'z' },
         {nullptr }
     };
     opterr = 0;
@@ -46,6 +50,9 @@ int program(int argc, char *argv[]) {
         case 'c':
             config_filename = optarg;
             break;
+        case 'z':
+            compress_filename = optarg;
+            break;
         case '?':
             if (optopt)
                 LOG(ERROR, "Bad option '-{}'", optopt);
@@ -56,11 +63,23 @@ int program(int argc, char *argv[]) {
             break;
         }
     }
+    if (compress_filename) {
+        /* convert image to chunked image, which is loaded in place of the original file */
+        return libretro::chunked_image_create(compress_filename, std::string(compress_filename) + CHUNKED_IMAGE_EXTENSION) ? 0 : 1;
+    }
     if (optind >= argc) {
         LOG(ERROR, "ROM filename missing.");
         return 1;
     }
-    const char *rom_filename = argv[optind];
+    std::string rom_path = argv[optind];
+    /* `file.srz` is loaded as `file`, which VFS serves from the chunked image */
+    bool rom_compressed = false;
+    size_t ext_len = strlen(CHUNKED_IMAGE_EXTENSION);
+    if (rom_path.size() > ext_len && strcasecmp(rom_path.c_str() + rom_path.size() - ext_len, CHUNKED_IMAGE_EXTENSION) == 0) {
+        rom_path.resize(rom_path.size() - ext_len);
+        rom_compressed = !helper::file_exists(rom_path);
+    }
+    const char *rom_filename = rom_path.c_str();
 
     if (config_filename) {
         g_cfg.load(config_filename);
@@ -91,10 +110,19 @@ int program(int argc, char *argv[]) {
 
     gui::ui_host ui(impl);
 
-    std::vector<uint8_t> unzipped_data;
+    /* entries of zip archive supported by any core */
+    struct zip_entry_info {
+        std::string name;
+        std::string ext;
+        bool playlist;
+    };
+    std::vector<zip_entry_info> zip_entries;
+    /* entry to load if rom is a zip archive */
+    std::string zip_entry;
     std::string rom_ext;
 
     std::string core_filepath;
+    const libretro::core_info *selected_core = nullptr;
     if (core_filename) {
         core_filepath = core_filename;
         if (!helper::file_exists(core_filepath)) {
@@ -132,32 +160,43 @@ int program(int argc, char *argv[]) {
 
         std::vector<const libretro::core_info *> core_list;
         if (strcasecmp(ptr, ".zip") == 0) {
-            do {
-                mz_zip_archive arc = {};
-                if (!mz_zip_reader_init_file(&arc, rom_filename, 0)) break;
+            mz_zip_archive arc = {};
+            if (mz_zip_reader_init_file(&arc, rom_filename, 0)) {
                 auto num_files = mz_zip_reader_get_num_files(&arc);
                 if (num_files == 0) {
                     LOG(ERROR, "Empty zip file!");
                     mz_zip_reader_end(&arc);
                     return 1;
                 }
-                if (num_files > 2)
-                    break;
+                /* playlists and cue sheets refer to other entries, so they are matched in any archive,
+                 * plain entries only in archives of at most 2 files, as arcade romsets hold many ROM chips
+                 * (e.g. *.bin) which would match console cores */
+                bool has_playlist = false;
                 for (uint32_t i = 0; i < num_files; ++i) {
                     mz_zip_archive_file_stat file_stat;
-                    mz_zip_reader_file_stat(&arc, 0, &file_stat);
+                    if (!mz_zip_reader_file_stat(&arc, i, &file_stat) || file_stat.m_is_directory) continue;
                     const char *ext_ptr = strrchr(file_stat.m_filename, '.');
                     if (ext_ptr == nullptr || strcasecmp(ext_ptr, ".txt") == 0) continue;
-                    rom_ext = ext_ptr + 1;
-                    core_list = coreman.match_cores_by_extension(rom_ext);
-                    if (!core_list.empty()) {
-                        unzipped_data.resize(file_stat.m_uncomp_size);
-                        mz_zip_reader_extract_to_mem(&arc, 0, &unzipped_data[0], file_stat.m_uncomp_size, 0);
-                        break;
-                    }
+                    bool playlist = strcasecmp(ext_ptr, ".m3u") == 0 || strcasecmp(ext_ptr, ".cue") == 0
+                        || strcasecmp(ext_ptr, ".gdi") == 0 || strcasecmp(ext_ptr, ".ccd") == 0;
+                    if (!playlist && num_files > 2) continue;
+                    if (coreman.match_cores_by_extension(ext_ptr + 1).empty()) continue;
+                    zip_entries.push_back({file_stat.m_filename, ext_ptr + 1, playlist});
+                    has_playlist = has_playlist || playlist;
                 }
                 mz_zip_reader_end(&arc);
-            } while (false);
+                /* offer cores of playlists if any, otherwise of plain entries */
+                for (auto &e: zip_entries) {
+                    if (e.playlist != has_playlist) continue;
+                    for (const auto *c: coreman.match_cores_by_extension(e.ext)) {
+                        if (std::find(core_list.begin(), core_list.end(), c) == core_list.end()) core_list.push_back(c);
+                    }
+                }
+            }
+            /* cores loading zip archives themselves are always offered */
+            for (const auto *c: coreman.match_cores_by_extension("zip")) {
+                if (std::find(core_list.begin(), core_list.end(), c) == core_list.end()) core_list.push_back(c);
+            }
         }
         if (core_list.empty()) {
             rom_ext = ptr + 1;
@@ -174,24 +213,68 @@ int program(int argc, char *argv[]) {
                 return 1;
             }
         }
-        core_filepath = core_list[index]->filepath;
+        selected_core = core_list[index];
+        core_filepath = selected_core->filepath;
     }
     if (!impl->load_core(core_filepath)) {
         LOG(ERROR, "Unable to load core from '{}'!", core_filepath);
         return 1;
     }
-    if (unzipped_data.empty()) {
+    if (selected_core && !zip_entries.empty()) {
+        /* pick entry supported by selected core, prefer playlists and cue sheets if core reads
+         * through VFS, as tracks they refer to are not extracted for cores opening files directly,
+         * the archive itself is loaded if no entry is supported */
+        bool via_vfs = !impl->get_need_fullpath() || impl->get_core_uses_vfs();
+        const zip_entry_info *pick = nullptr;
+        for (auto &e: zip_entries) {
+            if (e.playlist && !via_vfs) continue;
+            if (std::none_of(selected_core->extensions.begin(), selected_core->extensions.end(), [&e](const std::string &ext) {
+                return strcasecmp(ext.c_str(), e.ext.c_str()) == 0;
+            })) continue;
+            if (!pick || (e.playlist && !pick->playlist)) pick = &e;
+        }
+        if (pick) {
+            zip_entry = pick->name;
+            rom_ext = pick->ext;
+        } else {
+            rom_ext = "zip";
+        }
+    }
+    if (rom_compressed && impl->get_need_fullpath() && !impl->get_core_uses_vfs()) {
+        /* core opens files without VFS, decompress whole image for it */
+        std::vector<uint8_t> data;
+        if (!helper::read_file(rom_path, data)) {
+            LOG(ERROR, "Unable to read {}!", rom_path);
+            return 1;
+        }
+        if (rom_ext.empty()) {
+            const char *ptr = strrchr(rom_filename, '.');
+            if (ptr) rom_ext = ptr + 1;
+        }
+        impl->load_game_from_mem(rom_path, rom_ext, std::move(data));
+    } else if (zip_entry.empty()) {
         impl->load_game(rom_filename);
+    } else if (!impl->get_need_fullpath() || impl->get_core_uses_vfs()) {
+        /* read entry through archive VFS, no extraction needed */
+        impl->load_game(rom_filename, zip_entry);
     } else {
-        impl->load_game_from_mem(rom_filename, rom_ext, unzipped_data);
+        /* core opens files without VFS, extract entry for it */
+        if (!impl->load_game_from_archive(rom_filename, zip_entry, rom_ext)) return 1;
     }
     impl->run([&ui] { ui.in_game_menu(); });
     impl->unload_game();
+    libretro::vfs_dump_stats();
 
     return 0;
 }
 
 int main(int argc, char *argv[]) {
+#ifndef _WIN32
+    /* core probing process spawned by core_manager, runs before logger thread starts */
+    if (argc == 4 && strcmp(argv[1], "--probe-core") == 0) {
+        return libretro::core_manager::probe_core_process(argv[2], argv[3]);
+    }
+#endif
     setvbuf(stdout, nullptr, _IONBF, 0);
     setvbuf(stderr, nullptr, _IONBF, 0);
 